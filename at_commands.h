@@ -1,8 +1,8 @@
-#pragma once
-
-void startATPing();
-void queryCEREG();
-void setEncoding();
-void closeCh0();
-void openTCP();
+#pragma once
+
+void startATPing();
+void queryCEREG();
+void setEncoding();
+void closeCh0();
+void openTCP();
 void pollMIPSTATE();
\ No newline at end of file
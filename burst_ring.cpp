@@ -0,0 +1,63 @@
+#include "burst_ring.h"
+#include <esp_heap_caps.h>
+#include <string.h>
+
+static BurstFrame s_slots[BURST_RING_SLOTS];
+static uint32_t s_capacity = 0;
+static uint32_t s_head = 0;    // 最旧帧下标
+static uint32_t s_count = 0;
+
+bool burst_ring_init() {
+    if (s_capacity > 0) return true;
+    // 只用PSRAM：内部RAM放不下多帧JPEG，分配失败时退化为少槽位
+    for (uint32_t i = 0; i < BURST_RING_SLOTS; i++) {
+        uint8_t* mem = (uint8_t*)heap_caps_malloc(BURST_SLOT_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!mem) break;
+        s_slots[i].data = mem;
+        s_slots[i].cap = BURST_SLOT_SIZE;
+        s_slots[i].len = 0;
+        s_capacity++;
+    }
+    burst_ring_reset();
+    return s_capacity > 0;
+}
+
+void burst_ring_reset() {
+    s_head = 0;
+    s_count = 0;
+    for (uint32_t i = 0; i < s_capacity; i++) {
+        s_slots[i].len = 0;
+        s_slots[i].t_ms = 0;
+        s_slots[i].epoch = 0;
+        s_slots[i].name[0] = '\0';
+    }
+}
+
+uint32_t burst_ring_capacity() { return s_capacity; }
+uint32_t burst_ring_count() { return s_count; }
+
+BurstFrame* burst_ring_push(const uint8_t* data, size_t len, uint32_t t_ms, uint32_t epoch) {
+    if (!s_capacity || !data || len == 0 || len > BURST_SLOT_SIZE) return nullptr;
+
+    uint32_t idx;
+    if (s_count < s_capacity) {
+        idx = (s_head + s_count) % s_capacity;
+        s_count++;
+    } else {
+        // 满：覆盖最旧帧
+        idx = s_head;
+        s_head = (s_head + 1) % s_capacity;
+    }
+    BurstFrame* f = &s_slots[idx];
+    memcpy(f->data, data, len);
+    f->len = len;
+    f->t_ms = t_ms;
+    f->epoch = epoch;
+    f->name[0] = '\0';
+    return f;
+}
+
+BurstFrame* burst_ring_at(uint32_t i) {
+    if (i >= s_count) return nullptr;
+    return &s_slots[(s_head + i) % s_capacity];
+}
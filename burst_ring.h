@@ -0,0 +1,24 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// 连拍帧：数据区预分配在PSRAM，连拍过程中只做memcpy，不触碰SD
+struct BurstFrame {
+    uint8_t* data;
+    size_t   cap;
+    size_t   len;
+    uint32_t t_ms;       // 抓帧时刻 millis()
+    uint32_t epoch;      // 抓帧时刻 RTC 秒（RTC无效时为0）
+    char     name[64];   // 持久化后的文件名（未保存为空）
+};
+
+bool burst_ring_init();                 // 预分配槽位（可重复调用，已分配则直接返回）
+void burst_ring_reset();                // 清空已存帧（不释放内存）
+uint32_t burst_ring_capacity();         // 可用槽位数
+uint32_t burst_ring_count();            // 当前帧数
+
+// 复制一帧进环形槽；满时覆盖最旧帧；超出单槽容量返回nullptr
+BurstFrame* burst_ring_push(const uint8_t* data, size_t len, uint32_t t_ms, uint32_t epoch);
+
+// 按时间顺序取第i帧（0为最旧）
+BurstFrame* burst_ring_at(uint32_t i);
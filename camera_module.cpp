@@ -1,144 +1,343 @@
-#include "camera_module.h"
-#include "config.h"
-
-bool camera_ok = false;
-static uint32_t camera_reinit_backoff_ms = 0;
-static uint32_t camera_next_reinit_allowed = 0;
-static const uint32_t CAMERA_BACKOFF_BASE = 3000;
-static const uint32_t CAMERA_BACKOFF_MAX = 30000;
-
-// 统一的传感器参数调优（初始化后调用）
-static void tune_camera_sensor_defaults() {
-    sensor_t * s = esp_camera_sensor_get();
-    if (!s) return;
-
-    // 基础画质
-    s->set_brightness(s, 1);          // [-2..2] 适度提亮
-    s->set_contrast(s, 1);            // [-2..2]
-    s->set_saturation(s, 1);          // [-2..2]
-    s->set_sharpness(s, 1);           // [-2..2] 轻微锐化
-
-    // 色彩与白平衡
-    s->set_whitebal(s, 1);            // 开启白平衡
-    s->set_awb_gain(s, 1);            // 允许AWB增益
-    // s->set_wb_mode(s, 0);          // 0=Auto，如需固定白平衡可改为1..4
-
-    // 曝光与增益
-    s->set_exposure_ctrl(s, 1);       // 自动曝光
-    s->set_aec2(s, 1);                // 高级AEC
-    s->set_ae_level(s, 0);            // 曝光偏置 [-2..2]
-    s->set_gain_ctrl(s, 1);           // 自动增益
-    s->set_gainceiling(s, (gainceiling_t)3); // 增益上限（适中）
-
-    // 矫正与缩放
-    s->set_lenc(s, 1);                // 镜头阴影校正
-    s->set_dcw(s, 1);                 // 下采样优化（有助边缘与噪声）
-    s->set_raw_gma(s, 1);             // 伽马
-
-    // 方向（按需）
-    // s->set_hmirror(s, 0);
-    // s->set_vflip(s, 0);
-}
-
-camera_config_t make_config(framesize_t size, int xclk, int q) {
-    camera_config_t c;
-    c.ledc_channel = LEDC_CHANNEL_0;
-    c.ledc_timer = LEDC_TIMER_0;
-    c.pin_d0 = Y2_GPIO; c.pin_d1 = Y3_GPIO; c.pin_d2 = Y4_GPIO; c.pin_d3 = Y5_GPIO;
-    c.pin_d4 = Y6_GPIO; c.pin_d5 = Y7_GPIO; c.pin_d6 = Y8_GPIO; c.pin_d7 = Y9_GPIO;
-    c.pin_xclk = XCLK_GPIO; c.pin_pclk = PCLK_GPIO; c.pin_vsync = VSYNC_GPIO;
-    c.pin_href = HREF_GPIO; c.pin_sscb_sda = SIOD_GPIO; c.pin_sscb_scl = SIOC_GPIO;
-    c.pin_pwdn = PWDN_GPIO; c.pin_reset = RESET_GPIO;
-    c.xclk_freq_hz = xclk;
-    c.pixel_format = PIXFORMAT_JPEG;
-    if (psramFound()) {
-        c.frame_size = size; c.jpeg_quality = q; c.fb_count = 1;
-    } else {
-        c.frame_size = (size > FRAMESIZE_VGA ? FRAMESIZE_VGA : size);
-        c.jpeg_quality = q + 5; c.fb_count = 1;
-    }
-    return c;
-}
-
-bool try_camera_init_once(framesize_t size, int xclk, int q) {
-    camera_config_t cfg = make_config(size, xclk, q);
-    esp_err_t err = esp_camera_init(&cfg);
-    if (err == ESP_OK) {
-        tune_camera_sensor_defaults();
-        return true;
-    }
-    return false;
-}
-
-bool init_camera_multi() {
-    camera_ok = false; // 开始前先置为false
-    pinMode(PWDN_GPIO, OUTPUT); digitalWrite(PWDN_GPIO, LOW); delay(30);
-
-    // 优先档
-    for (int i = 0; i < INIT_RETRY_PER_CONFIG; i++) {
-        if (try_camera_init_once(FRAME_SIZE_PREF, 20000000, JPEG_QUALITY_PREF)) {
-            camera_ok = true;
-            // 上电后适当丢帧，促使AWB/AE收敛
-            discard_frames(DISCARD_FRAMES_ON_START);
-            return true;
-        }
-        delay(120);
-    }
-
-    // 降级档
-    esp_camera_deinit(); delay(60);
-    for (int i = 0; i < INIT_RETRY_PER_CONFIG; i++) {
-        if (try_camera_init_once(FRAME_SIZE_FALLBACK, 10000000, JPEG_QUALITY_FALLBACK)) {
-            camera_ok = true;
-            discard_frames(DISCARD_FRAMES_ON_START);
-            return true;
-        }
-        delay(150);
-    }
-
-    esp_camera_deinit();
-    camera_ok = false;
-    return false;
-}
-
-void deinit_camera_silent() { esp_camera_deinit(); delay(50); }
-
-bool discard_frames(int n) {
-    for (int i = 0; i < n; i++) {
-        camera_fb_t *fb = esp_camera_fb_get();
-        if (!fb) return false;
-        esp_camera_fb_return(fb);
-    }
-    return true;
-}
-
-bool reinit_camera_with_params(framesize_t size, int quality) {
-    deinit_camera_silent();
-    camera_config_t cfg = make_config(size, 20000000, quality);
-    if (esp_camera_init(&cfg) == ESP_OK) {
-        tune_camera_sensor_defaults();
-        camera_ok = true;
-        return true;
-    }
-    deinit_camera_silent();
-    cfg = make_config(size, 10000000, quality + 2);
-    if (esp_camera_init(&cfg) == ESP_OK) {
-        tune_camera_sensor_defaults();
-        camera_ok = true;
-        return true;
-    }
-    camera_ok = false;
-    return false;
-}
-
-void schedule_camera_backoff() {
-    camera_reinit_backoff_ms = camera_reinit_backoff_ms ? min<uint32_t>(camera_reinit_backoff_ms * 2, CAMERA_BACKOFF_MAX) : CAMERA_BACKOFF_BASE;
-    camera_next_reinit_allowed = millis() + camera_reinit_backoff_ms;
-}
-void attempt_camera_reinit_with_backoff() {
-    uint32_t now = millis();
-    if (now < camera_next_reinit_allowed) return;
-    deinit_camera_silent();
-    camera_ok = init_camera_multi();
-    if (!camera_ok) schedule_camera_backoff(); else camera_reinit_backoff_ms = 0;
+#include "camera_module.h"
+#include "jpeg_quality_ctl.h"
+#include "sensor_roi.h"
+#include "crc16.h"
+#include "config.h"
+#include <Preferences.h>
+#include "esp_attr.h"
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+bool camera_ok = false;
+static uint32_t camera_reinit_backoff_ms = 0;
+static uint32_t camera_next_reinit_allowed = 0;
+static const uint32_t CAMERA_BACKOFF_BASE = 3000;
+static const uint32_t CAMERA_BACKOFF_MAX = 30000;
+
+// ===== 热启动缓存：记录最近一次成功的初始化参数，下次优先尝试 =====
+// RTC慢速内存跨软复位保留（重初始化/看门狗复位），NVS兜底冷启动
+static const uint32_t CAM_WARM_MAGIC = 0x43414D31; // "CAM1"
+
+struct CamWarmCfg {
+    uint32_t magic;
+    uint8_t  framesize;
+    uint8_t  quality;
+    int8_t   brightness, contrast, saturation, sharpness, ae_level;
+    uint8_t  gainceiling;
+    uint32_t xclk;
+    uint16_t crc;
+};
+
+RTC_NOINIT_ATTR static CamWarmCfg s_rtc_warm;
+static uint32_t s_last_nvs_save_ms = 0;
+static bool     s_nvs_saved_once = false;
+static uint32_t s_camera_ready_ms = 0;     // 上电到相机就绪（millis）
+static uint32_t s_camera_init_cost_ms = 0; // 最近一次初始化耗时
+static bool     s_last_init_warm = false;
+static uint32_t s_init_gen = 0;
+static CamGrabStats s_grab = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+static SemaphoreHandle_t s_cam_mtx = nullptr;
+static bool     s_on_fallback = false;   // 初始化只成功了降级档（非 FRAME_SIZE_PREF/20MHz），监督任务定期再试优先档
+static bool     s_runtime_override = false; // 画质闭环运行中降了分辨率：不写热启动缓存
+
+static uint16_t warm_crc(const CamWarmCfg& c) {
+    return crc16_modbus((const uint8_t*)&c, offsetof(CamWarmCfg, crc));
+}
+
+static bool warm_valid(const CamWarmCfg& c) {
+    return c.magic == CAM_WARM_MAGIC && c.crc == warm_crc(c) && c.xclk > 0;
+}
+
+static bool warm_load(CamWarmCfg& out) {
+    if (warm_valid(s_rtc_warm)) { out = s_rtc_warm; return true; }
+    Preferences p;
+    if (!p.begin("cam", true)) return false;
+    size_t n = p.getBytes("warm", &out, sizeof(out));
+    p.end();
+    if (n != sizeof(out) || !warm_valid(out)) return false;
+    s_rtc_warm = out;
+    return true;
+}
+
+// 写NVS：内容变化才写，且受 NVS_MIN_SAVE_INTERVAL_MS 节流（首次除外）
+static void warm_persist(bool force) {
+    uint32_t now = millis();
+    if (!force && s_nvs_saved_once && now - s_last_nvs_save_ms < NVS_MIN_SAVE_INTERVAL_MS) return;
+    Preferences p;
+    if (!p.begin("cam", false)) return;
+    CamWarmCfg old;
+    if (p.getBytes("warm", &old, sizeof(old)) != sizeof(old) || memcmp(&old, &s_rtc_warm, sizeof(old)) != 0) {
+        p.putBytes("warm", &s_rtc_warm, sizeof(s_rtc_warm));
+    }
+    p.end();
+    s_last_nvs_save_ms = now;
+    s_nvs_saved_once = true;
+}
+
+static void warm_store(framesize_t size, int xclk, int q) {
+    sensor_t* s = esp_camera_sensor_get();
+    CamWarmCfg c;
+    memset(&c, 0, sizeof(c));
+    c.magic = CAM_WARM_MAGIC;
+    c.framesize = (uint8_t)size;
+    c.quality = (uint8_t)q;
+    c.xclk = (uint32_t)xclk;
+    if (s) {
+        c.brightness = s->status.brightness;
+        c.contrast = s->status.contrast;
+        c.saturation = s->status.saturation;
+        c.sharpness = s->status.sharpness;
+        c.ae_level = s->status.ae_level;
+        c.gainceiling = (uint8_t)s->status.gainceiling;
+    }
+    c.crc = warm_crc(c);
+    bool changed = memcmp(&c, &s_rtc_warm, sizeof(c)) != 0;
+    s_rtc_warm = c;
+    if (changed) warm_persist(true);
+}
+
+// 在默认调优之上叠加缓存的传感器参数
+static void warm_apply_regs(const CamWarmCfg& c) {
+    sensor_t* s = esp_camera_sensor_get();
+    if (!s) return;
+    s->set_brightness(s, c.brightness);
+    s->set_contrast(s, c.contrast);
+    s->set_saturation(s, c.saturation);
+    s->set_sharpness(s, c.sharpness);
+    s->set_ae_level(s, c.ae_level);
+    s->set_gainceiling(s, (gainceiling_t)c.gainceiling);
+}
+
+// 统一的传感器参数调优（初始化后调用）
+static void tune_camera_sensor_defaults() {
+    sensor_t * s = esp_camera_sensor_get();
+    if (!s) return;
+
+    // 基础画质
+    s->set_brightness(s, 1);          // [-2..2] 适度提亮
+    s->set_contrast(s, 1);            // [-2..2]
+    s->set_saturation(s, 1);          // [-2..2]
+    s->set_sharpness(s, 1);           // [-2..2] 轻微锐化
+
+    // 色彩与白平衡
+    s->set_whitebal(s, 1);            // 开启白平衡
+    s->set_awb_gain(s, 1);            // 允许AWB增益
+    // s->set_wb_mode(s, 0);          // 0=Auto，如需固定白平衡可改为1..4
+
+    // 曝光与增益
+    s->set_exposure_ctrl(s, 1);       // 自动曝光
+    s->set_aec2(s, 1);                // 高级AEC
+    s->set_ae_level(s, 0);            // 曝光偏置 [-2..2]
+    s->set_gain_ctrl(s, 1);           // 自动增益
+    s->set_gainceiling(s, (gainceiling_t)3); // 增益上限（适中）
+
+    // 矫正与缩放
+    s->set_lenc(s, 1);                // 镜头阴影校正
+    s->set_dcw(s, 1);                 // 下采样优化（有助边缘与噪声）
+    s->set_raw_gma(s, 1);             // 伽马
+
+    // 方向（按需）
+    // s->set_hmirror(s, 0);
+    // s->set_vflip(s, 0);
+
+    // 开窗（ROI_ENABLE时）：每次初始化后重新下发，窗口寄存器不会跨 deinit 保留
+    roi_apply(s);
+}
+
+camera_config_t make_config(framesize_t size, int xclk, int q) {
+    camera_config_t c;
+    c.ledc_channel = LEDC_CHANNEL_0;
+    c.ledc_timer = LEDC_TIMER_0;
+    c.pin_d0 = Y2_GPIO; c.pin_d1 = Y3_GPIO; c.pin_d2 = Y4_GPIO; c.pin_d3 = Y5_GPIO;
+    c.pin_d4 = Y6_GPIO; c.pin_d5 = Y7_GPIO; c.pin_d6 = Y8_GPIO; c.pin_d7 = Y9_GPIO;
+    c.pin_xclk = XCLK_GPIO; c.pin_pclk = PCLK_GPIO; c.pin_vsync = VSYNC_GPIO;
+    c.pin_href = HREF_GPIO; c.pin_sscb_sda = SIOD_GPIO; c.pin_sscb_scl = SIOC_GPIO;
+    c.pin_pwdn = PWDN_GPIO; c.pin_reset = RESET_GPIO;
+    c.xclk_freq_hz = xclk;
+    c.pixel_format = PIXFORMAT_JPEG;
+    if (psramFound()) {
+        c.frame_size = size; c.jpeg_quality = q; c.fb_count = 1;
+    } else {
+        c.frame_size = (size > FRAMESIZE_VGA ? FRAMESIZE_VGA : size);
+        c.jpeg_quality = q + 5; c.fb_count = 1;
+    }
+    return c;
+}
+
+bool try_camera_init_once(framesize_t size, int xclk, int q) {
+    camera_config_t cfg = make_config(size, xclk, q);
+    esp_err_t err = esp_camera_init(&cfg);
+    if (err == ESP_OK) {
+        tune_camera_sensor_defaults();
+        return true;
+    }
+    return false;
+}
+
+// 初始化成功后的统一收尾。store=false：运行中的临时参数（画质闭环降档），不进热启动缓存
+static bool on_camera_ready(framesize_t size, int xclk, int q, uint32_t t0, bool warm, bool store = true) {
+    camera_ok = true;
+    qctl_init(q);
+    s_runtime_override = !store;
+    if (store) {
+        warm_store(size, xclk, q);
+        s_on_fallback = (size != FRAME_SIZE_PREF || xclk != 20000000);
+    }
+    // 上电后适当丢帧，促使AWB/AE收敛
+    discard_frames(DISCARD_FRAMES_ON_START);
+    s_camera_init_cost_ms = millis() - t0;
+    s_camera_ready_ms = millis();
+    s_last_init_warm = warm;
+    s_grab.consecutive_fail = 0;
+    s_init_gen++;
+    return true;
+}
+
+bool init_camera_multi() {
+    camera_ok = false; // 开始前先置为false
+    uint32_t t0 = millis();
+    pinMode(PWDN_GPIO, OUTPUT); digitalWrite(PWDN_GPIO, LOW); delay(30);
+
+    // 热启动：先试上次成功的参数（只试一次，失败再走常规档位）
+    CamWarmCfg w;
+    if (warm_load(w)) {
+        if (try_camera_init_once((framesize_t)w.framesize, (int)w.xclk, w.quality)) {
+            warm_apply_regs(w);
+            return on_camera_ready((framesize_t)w.framesize, (int)w.xclk, w.quality, t0, true);
+        }
+        esp_camera_deinit(); delay(60);
+    }
+
+    // 优先档
+    for (int i = 0; i < INIT_RETRY_PER_CONFIG; i++) {
+        if (try_camera_init_once(FRAME_SIZE_PREF, 20000000, JPEG_QUALITY_PREF)) {
+            return on_camera_ready(FRAME_SIZE_PREF, 20000000, JPEG_QUALITY_PREF, t0, false);
+        }
+        delay(120);
+    }
+
+    // 降级档
+    esp_camera_deinit(); delay(60);
+    for (int i = 0; i < INIT_RETRY_PER_CONFIG; i++) {
+        if (try_camera_init_once(FRAME_SIZE_FALLBACK, 10000000, JPEG_QUALITY_FALLBACK)) {
+            return on_camera_ready(FRAME_SIZE_FALLBACK, 10000000, JPEG_QUALITY_FALLBACK, t0, false);
+        }
+        delay(150);
+    }
+
+    esp_camera_deinit();
+    camera_ok = false;
+    s_camera_init_cost_ms = millis() - t0;
+    return false;
+}
+
+// 画质闭环收敛后回写缓存画质，下次热启动直接用
+void camera_warm_note_quality(int q) {
+    if (s_runtime_override) return;
+    if (!warm_valid(s_rtc_warm) || s_rtc_warm.quality == (uint8_t)q) return;
+    s_rtc_warm.quality = (uint8_t)q;
+    s_rtc_warm.crc = warm_crc(s_rtc_warm);
+    warm_persist(false);
+}
+
+uint32_t camera_ready_ms() { return s_camera_ready_ms; }
+uint32_t camera_last_init_cost_ms() { return s_camera_init_cost_ms; }
+bool camera_last_init_was_warm() { return s_last_init_warm; }
+
+void deinit_camera_silent() { esp_camera_deinit(); delay(50); }
+
+// setup 中、相机初始化与监督任务启动之前调用一次（此时只有一个任务，不存在创建竞争）
+bool camera_lock_init() {
+    if (!s_cam_mtx) s_cam_mtx = xSemaphoreCreateRecursiveMutex();
+    return s_cam_mtx != nullptr;
+}
+
+bool camera_lock(uint32_t timeout_ms) {
+    if (!s_cam_mtx) return false;
+    return xSemaphoreTakeRecursive(s_cam_mtx, pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+}
+
+void camera_unlock() {
+    if (s_cam_mtx) xSemaphoreGiveRecursive(s_cam_mtx);
+}
+
+camera_fb_t* camera_grab() {
+    uint32_t startMs = millis();
+    s_grab.busy_since_ms = startMs ? startMs : 1;
+    int64_t t0 = esp_timer_get_time();
+    camera_fb_t* fb = esp_camera_fb_get();
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+    s_grab.busy_since_ms = 0;
+    s_grab.last_grab_ms = millis();
+    s_grab.last_us = us;
+    if (us > s_grab.max_us) s_grab.max_us = us;
+    if (fb) {
+        s_grab.grabs++;
+        s_grab.consecutive_fail = 0;
+        s_grab.sum_us += us;
+        s_grab.ewma_us = s_grab.ewma_us ? s_grab.ewma_us + ((int32_t)(us - s_grab.ewma_us) >> 3) : us;
+    } else {
+        s_grab.failures++;
+        s_grab.consecutive_fail++;
+    }
+    return fb;
+}
+
+void camera_get_grab_stats(CamGrabStats& out) { out = s_grab; }
+uint32_t camera_init_generation() { return s_init_gen; }
+
+bool discard_frames(int n) {
+    for (int i = 0; i < n; i++) {
+        camera_fb_t *fb = camera_grab();
+        if (!fb) return false;
+        esp_camera_fb_return(fb);
+    }
+    return true;
+}
+
+// 运行中换分辨率/画质（画质闭环兜底）：走 on_camera_ready 收尾使代数+1，但不写热启动缓存，
+// 下次上电仍按缓存/优先档初始化
+bool reinit_camera_with_params(framesize_t size, int quality) {
+    uint32_t t0 = millis();
+    camera_ok = false;
+    deinit_camera_silent();
+    if (try_camera_init_once(size, 20000000, quality)) {
+        return on_camera_ready(size, 20000000, quality, t0, false, false);
+    }
+    deinit_camera_silent();
+    if (try_camera_init_once(size, 10000000, quality + 2)) {
+        return on_camera_ready(size, 10000000, quality + 2, t0, false, false);
+    }
+    deinit_camera_silent();
+    return false;
+}
+
+bool camera_on_fallback_tier() { return s_on_fallback && !s_runtime_override; }
+
+// 当前是降级档：试一次优先档，不行就按常规流程（热启动缓存即降级档）恢复。调用方须持有相机锁
+bool camera_retry_preferred() {
+    if (!camera_on_fallback_tier()) return false;
+    uint32_t t0 = millis();
+    camera_ok = false;
+    deinit_camera_silent();
+    if (try_camera_init_once(FRAME_SIZE_PREF, 20000000, JPEG_QUALITY_PREF)) {
+        return on_camera_ready(FRAME_SIZE_PREF, 20000000, JPEG_QUALITY_PREF, t0, false);
+    }
+    deinit_camera_silent();
+    init_camera_multi();
+    return false;
+}
+
+void schedule_camera_backoff() {
+    camera_reinit_backoff_ms = camera_reinit_backoff_ms ? min<uint32_t>(camera_reinit_backoff_ms * 2, CAMERA_BACKOFF_MAX) : CAMERA_BACKOFF_BASE;
+    camera_next_reinit_allowed = millis() + camera_reinit_backoff_ms;
+}
+bool attempt_camera_reinit_with_backoff() {
+    uint32_t now = millis();
+    if ((int32_t)(now - camera_next_reinit_allowed) < 0) return false;
+    deinit_camera_silent();
+    camera_ok = init_camera_multi();
+    if (!camera_ok) schedule_camera_backoff(); else camera_reinit_backoff_ms = 0;
+    return true;
 }
\ No newline at end of file
@@ -1,13 +1,44 @@
-#pragma once
-#include <Arduino.h>
-#include "esp_camera.h"
-#include "config.h"
-
-bool try_camera_init_once(framesize_t size, int xclk, int q);
-bool init_camera_multi();
-void deinit_camera_silent();
-bool discard_frames(int n);
-bool reinit_camera_with_params(framesize_t size, int quality);
-void schedule_camera_backoff();
-void attempt_camera_reinit_with_backoff();
+#pragma once
+#include <Arduino.h>
+#include "esp_camera.h"
+#include "config.h"
+
+bool try_camera_init_once(framesize_t size, int xclk, int q);
+bool init_camera_multi();
+void deinit_camera_silent();
+bool discard_frames(int n);
+bool reinit_camera_with_params(framesize_t size, int quality);
+void schedule_camera_backoff();
+bool attempt_camera_reinit_with_backoff();   // 退避期内返回false（未尝试）；结果看 camera_ok
+
+// 热启动缓存与就绪耗时
+void camera_warm_note_quality(int q);       // 画质闭环调整后回写缓存
+uint32_t camera_ready_ms();                 // 最近一次相机就绪时刻（上电起 millis）
+uint32_t camera_last_init_cost_ms();        // 最近一次 init_camera_multi 耗时
+bool camera_last_init_was_warm();           // 最近一次是否命中热启动缓存
+bool camera_on_fallback_tier();             // 初始化只成功了降级档（不含画质闭环的运行中降档）
+bool camera_retry_preferred();              // 降级档时再试优先档，成功返回 true；须持有相机锁
+// 取帧统计（所有取帧都经 camera_grab，供健康监督使用）
+struct CamGrabStats {
+    uint32_t grabs;             // 成功取帧数
+    uint32_t failures;          // 取帧失败总数
+    uint32_t consecutive_fail;  // 连续失败数（成功或重初始化后清零）
+    uint32_t last_us;           // 最近一次取帧耗时
+    uint32_t ewma_us;           // 取帧耗时滑动平均（1/8）
+    uint32_t max_us;
+    uint64_t sum_us;            // 成功取帧耗时累计（求窗口均值用）
+    uint32_t last_grab_ms;      // 最近一次取帧结束时刻
+    uint32_t busy_since_ms;     // 正在取帧的开始时刻（0 表示空闲）
+};
+
+camera_fb_t* camera_grab();                 // esp_camera_fb_get + 计时/失败统计
+void camera_get_grab_stats(CamGrabStats& out);
+uint32_t camera_init_generation();          // 每次初始化成功+1，缓存传感器状态的模块据此失效
+
+// 相机互斥：主循环拍照与监督任务重初始化互斥（递归锁，可嵌套）。
+// camera_lock_init 须在 setup 早期调用；未创建时 camera_lock 一律失败
+bool camera_lock_init();
+bool camera_lock(uint32_t timeout_ms);
+void camera_unlock();
+
 extern bool camera_ok;
\ No newline at end of file
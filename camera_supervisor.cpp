@@ -0,0 +1,165 @@
+#include "camera_supervisor.h"
+#include "camera_module.h"
+#include "sd_async.h"
+#include "uart_utils.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static TaskHandle_t s_task = nullptr;
+static CamHealth s_health = {0, 0, 0, 0, 0, 0};
+
+// 取帧耗时窗口环
+static CamLatencyWindow s_win[CAM_SUP_TREND_DEPTH];
+static uint32_t s_win_head = 0;
+static uint32_t s_win_count = 0;
+static uint32_t s_win_start_ms = 0;
+static uint32_t s_win_grabs0 = 0, s_win_fail0 = 0;
+static uint64_t s_win_sum0 = 0;
+
+static const char* volatile s_reboot_why = nullptr;   // 待主循环执行的重启
+static uint32_t s_reboot_req_ms = 0;
+static uint32_t s_pref_try_ms = 0;
+
+static void reboot_now(const char* why) {
+    log2Str("[CAMSUP] Reboot: ", why);
+    sd_async_stop(true);   // 尽量把排队中的照片写完
+    delay(100);
+    esp_restart();
+}
+
+// 主循环还在转时由它重启：合并中的追加记录只能由主循环提交。主循环也卡住则超时后自己重启
+static void reboot_request(const char* why) {
+    if (!s_reboot_why) {
+        s_reboot_req_ms = millis();
+        s_reboot_why = why;
+        return;
+    }
+    if (millis() - s_reboot_req_ms > CAM_SUP_REBOOT_HANDOFF_MS) reboot_now(s_reboot_why);
+}
+
+void camera_supervisor_poll() {
+    const char* why = s_reboot_why;
+    if (!why) return;
+    log2Str("[CAMSUP] Reboot: ", why);
+    sd_async_append_flush();
+    sd_async_stop(true);
+    delay(100);
+    esp_restart();
+}
+
+static void update_trend() {
+    int32_t newest = -1, oldest = -1;
+    for (uint32_t age = 0; age < s_win_count; age++) {
+        CamLatencyWindow w;
+        camera_supervisor_window(age, w);
+        if (!w.grabs) continue;
+        if (newest < 0) newest = (int32_t)w.avg_us;
+        oldest = (int32_t)w.avg_us;
+    }
+    s_health.trend_us = (newest >= 0) ? newest - oldest : 0;
+    s_health.trend_count = s_win_count;
+}
+
+// 窗口到期：按累计量求差得到本窗口的取帧数/失败数/平均耗时
+static void roll_window(const CamGrabStats& g, uint32_t now) {
+    if (now - s_win_start_ms < CAM_SUP_TREND_WINDOW_MS) return;
+    CamLatencyWindow& w = s_win[s_win_head];
+    w.end_ms = now;
+    w.grabs = g.grabs - s_win_grabs0;
+    w.failures = g.failures - s_win_fail0;
+    w.avg_us = w.grabs ? (uint32_t)((g.sum_us - s_win_sum0) / w.grabs) : 0;
+    w.max_us = g.max_us;
+    s_win_head = (s_win_head + 1) % CAM_SUP_TREND_DEPTH;
+    if (s_win_count < CAM_SUP_TREND_DEPTH) s_win_count++;
+    s_win_start_ms = now;
+    s_win_grabs0 = g.grabs;
+    s_win_fail0 = g.failures;
+    s_win_sum0 = g.sum_us;
+    update_trend();
+#if ENABLE_STATS_LOG && ENABLE_LOG2
+    Serial2.printf("[CAMSUP] grabs=%lu fail=%lu avg=%luus ewma=%luus max=%luus trend=%ldus\r\n",
+                   (unsigned long)w.grabs, (unsigned long)w.failures, (unsigned long)w.avg_us,
+                   (unsigned long)g.ewma_us, (unsigned long)g.max_us, (long)s_health.trend_us);
+#endif
+}
+
+// 相机掉线或连续取帧失败：按已有退避策略重初始化，连续失败超限重启
+static void recover() {
+#if ENABLE_AUTO_REINIT
+    if (!attempt_camera_reinit_with_backoff()) return;   // 退避期内
+    if (camera_ok) {
+        s_health.reinits++;
+        s_health.reinit_failures = 0;
+        s_health.last_reinit_ms = millis();
+        log2Val("[CAMSUP] Camera reinit OK, count=", (int)s_health.reinits);
+        return;
+    }
+    s_health.reinit_failures++;
+    log2Val("[CAMSUP] Camera reinit failed, streak=", (int)s_health.reinit_failures);
+    if (s_health.reinit_failures >= CAPTURE_FAIL_REBOOT_THRESHOLD) reboot_request("camera reinit");
+#endif
+}
+
+static void tick() {
+    uint32_t now = millis();
+
+    // 取帧卡死时主循环持有相机锁，这里无锁判定
+    CamGrabStats g;
+    camera_get_grab_stats(g);
+    if (g.busy_since_ms && now - g.busy_since_ms > CAM_SUP_STALL_REBOOT_MS) reboot_now("grab stalled");   // 主循环卡在取帧里，不交接
+    if (s_reboot_why) reboot_request(s_reboot_why);
+    if (g_stats.consecutive_capture_fail >= CAPTURE_FAIL_REBOOT_THRESHOLD) reboot_request("capture failures");
+
+    // 其余操作需独占相机；主循环正在拍照则下个周期再看
+    if (!camera_lock(0)) return;
+    camera_get_grab_stats(g);
+    if (camera_ok && g.consecutive_fail >= RUNTIME_FAIL_REINIT_THRESHOLD) {
+        log2Val("[CAMSUP] Grab failures, reinit. streak=", (int)g.consecutive_fail);
+        camera_ok = false;
+    }
+    if (!camera_ok) {
+        recover();
+    } else if (camera_on_fallback_tier() && now - s_pref_try_ms > CAM_SUP_PREF_RETRY_MS) {
+        // 降级档可能只是一次偶发失败：定期回到优先档，成功后热启动缓存随之更新
+        s_pref_try_ms = now;
+        if (camera_retry_preferred()) log2("[CAMSUP] Back on preferred camera tier.");
+    } else if (now - g.last_grab_ms > CAM_SUP_PROBE_IDLE_MS) {
+        // 长时间没人取帧：试取一帧，传感器挂死也能及时发现
+        s_health.probes++;
+        camera_fb_t* fb = camera_grab();
+        if (fb) esp_camera_fb_return(fb);
+    }
+    camera_get_grab_stats(g);
+    roll_window(g, now);
+    camera_unlock();
+}
+
+static void supervisor_task(void*) {
+    s_win_start_ms = millis();
+    for (;;) {
+        tick();
+        vTaskDelay(pdMS_TO_TICKS(CAM_SUP_PERIOD_MS));
+    }
+}
+
+bool camera_supervisor_start() {
+#if CAM_SUP_ENABLE
+    if (s_task) return true;
+    BaseType_t rc = xTaskCreatePinnedToCore(supervisor_task, "camsup",
+                                            CAM_SUP_TASK_STACK, nullptr,
+                                            CAM_SUP_TASK_PRIO, &s_task,
+                                            tskNO_AFFINITY);
+    return rc == pdPASS;
+#else
+    return false;
+#endif
+}
+
+void camera_supervisor_get(CamHealth& out) { out = s_health; }
+
+bool camera_supervisor_window(uint32_t age, CamLatencyWindow& out) {
+    if (age >= s_win_count) return false;
+    uint32_t idx = (s_win_head + CAM_SUP_TREND_DEPTH - 1 - age) % CAM_SUP_TREND_DEPTH;
+    out = s_win[idx];
+    return true;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// 一个统计窗口内的取帧情况
+struct CamLatencyWindow {
+    uint32_t end_ms;        // 窗口结束时刻
+    uint32_t grabs;         // 成功取帧数
+    uint32_t failures;      // 失败数
+    uint32_t avg_us;        // 平均耗时（无取帧时为0）
+    uint32_t max_us;        // 截至窗口结束的历史最大耗时
+};
+
+struct CamHealth {
+    uint32_t reinits;           // 后台重初始化成功次数
+    uint32_t reinit_failures;   // 连续重初始化失败次数
+    uint32_t probes;            // 空闲探测取帧次数
+    uint32_t last_reinit_ms;
+    int32_t  trend_us;          // 最新窗口均值 - 最早窗口均值（>0 表示取帧变慢）
+    uint32_t trend_count;       // 已有窗口数
+};
+
+// 启动监督任务：相机掉线/连续取帧失败时按退避重初始化，超过阈值重启
+bool camera_supervisor_start();
+// 主循环调用：执行监督任务请求的重启（先落盘合并的追加记录）
+void camera_supervisor_poll();
+
+void camera_supervisor_get(CamHealth& out);
+// 取帧耗时窗口：age=0 为最近一个窗口
+bool camera_supervisor_window(uint32_t age, CamLatencyWindow& out);
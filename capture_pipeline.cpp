@@ -0,0 +1,235 @@
+#include "capture_pipeline.h"
+#include "capture_trigger.h"
+#include "flash_module.h"
+#include "camera_module.h"
+#include "sdcard_module.h"
+#include "jpeg_quality_ctl.h"
+#include "water_level.h"
+#include "change_detect.h"
+#include "motion_watch.h"
+#include "photo_cache.h"
+#include "uart_utils.h"
+#include <esp_timer.h>
+#include <string.h>
+
+// 来自 main.ino 的事件上传标志
+extern volatile int g_monitorEventUploadFlag;
+
+static CaptureTrace s_traces[CAP_TRACE_DEPTH];
+static uint32_t s_trace_head = 0;    // 下一个写入位置
+static uint32_t s_trace_count = 0;
+static uint32_t s_seq = 0;
+
+static const char* const STAGE_NAMES[CAP_STAGE_COUNT] = {
+    "warmup", "grab", "qcheck", "fallback", "persist", "notify"
+};
+
+const char* capture_stage_name(CaptureStage st) {
+    return st < CAP_STAGE_COUNT ? STAGE_NAMES[st] : "?";
+}
+
+// 记录阶段耗时并推进时间戳
+static inline void mark(CaptureTrace& tr, CaptureStage st, int64_t& t) {
+    int64_t now = esp_timer_get_time();
+    tr.stage_us[st] += (uint32_t)(now - t);
+    t = now;
+}
+
+// 依据JPEG长度的“暗场”近似判定（补光被遮挡/光照很暗时，JPEG更小）
+static inline bool is_dark_jpeg(size_t jpeg_len) {
+    // 经验阈值：SVGA在极暗场常<16~18KB，可按需在config.h中调参；画质闭环调整后按比例换算
+    const size_t TH = qctl_dark_threshold(); // 默认16000
+    return jpeg_len > 0 && jpeg_len < TH;
+}
+
+// 低照度短时提升：用于重拍前提亮（关灯重拍时使用）
+static void apply_lowlight_boost(bool enable) {
+    sensor_t *s = esp_camera_sensor_get();
+    if (!s) return;
+    if (enable) {
+        s->set_aec2(s, 1);
+        s->set_ae_level(s, 2);                    // 曝光偏置拉高
+        s->set_gain_ctrl(s, 1);
+        s->set_gainceiling(s, (gainceiling_t)4);  // 放宽增益上限
+        s->set_brightness(s, 1);
+        // AWB继续开，避免强偏色
+        s->set_whitebal(s, 1);
+        s->set_awb_gain(s, 1);
+    } else {
+        // 回到默认偏保守的水平，避免后续过曝/偏色
+        s->set_ae_level(s, 0);
+        s->set_gainceiling(s, (gainceiling_t)3);
+        s->set_brightness(s, 1);
+        s->set_whitebal(s, 1);
+        s->set_awb_gain(s, 1);
+    }
+}
+
+void capture_stage_warmup() {
+    motion_watch_release_sensor();   // 监视模式下先恢复全分辨率，随后的丢帧兼作稳定
+    flashOn();
+    delay(flash_warm_ms());   // 已标定时用实测预热时长
+    if (DISCARD_FRAMES_EACH_SHOT > 0) {
+        discard_frames(DISCARD_FRAMES_EACH_SHOT);
+    }
+}
+
+// 记录待上传照片并通知上传管理器
+void capture_publish_for_upload(const char* photoFile, uint8_t trigger) {
+    photo_cache_unpin(g_lastPhotoName);   // 上一张未及上传即被覆盖，不再钉住
+    photo_cache_pin(photoFile);
+    strncpy(g_lastPhotoName, photoFile, sizeof(g_lastPhotoName) - 1);
+    g_lastPhotoName[sizeof(g_lastPhotoName)-1] = '\0';
+    g_lastTriggerCond = trigger;
+    g_lastEventMetaOnly = false;
+    g_monitorEventUploadFlag = 1; // 通知上传管理器
+}
+
+// 画面与上次保存的无变化：不落盘，事件只发元数据
+static void publish_meta_only(uint8_t trigger) {
+    photo_cache_unpin(g_lastPhotoName);   // 上一张未及上传即被覆盖，不再钉住
+    g_lastPhotoName[0] = '\0';
+    g_lastTriggerCond = trigger;
+    g_lastEventMetaOnly = true;
+    g_monitorEventUploadFlag = 1;
+}
+
+void capture_default_options(CaptureOptions& o, uint8_t trigger, bool upload) {
+    o.trigger = trigger;
+    o.warmup = true;
+    o.dark_fallback = true;
+    o.persist = true;
+    o.change_detect = true;
+    o.analyze = true;
+    o.upload = upload;
+}
+
+// 各阶段顺序执行；出错即返回，fb/补光/提亮的收尾由调用方统一处理
+static uint8_t run_stages(const CaptureOptions& opt, CaptureTrace& tr,
+                          camera_fb_t*& fb, bool& boosted) {
+    int64_t t = tr.t_start_us;
+    if (!camera_ok) return CR_CAMERA_NOT_READY;
+
+    // 1) 预热（画质在预热丢帧期间生效）
+    QctlScene scene = QCTL_SCENE_FLASH;
+    qctl_before_capture(scene);
+    if (opt.warmup) capture_stage_warmup();
+    mark(tr, CAP_STAGE_WARMUP, t);
+
+    // 2) 取帧
+    fb = camera_grab();
+    mark(tr, CAP_STAGE_GRAB, t);
+    if (!fb) return CR_FRAME_GRAB_FAIL;
+    qctl_after_capture(scene, fb->len);
+
+    // 3) 暗场判定（补光被遮/极暗）
+    bool dark = opt.dark_fallback && is_dark_jpeg(fb->len);
+    flashOff();
+    mark(tr, CAP_STAGE_QCHECK, t);
+
+    // 4) 回退：关灯 + 提升曝光/增益 + 丢帧后重拍
+    if (dark) {
+        tr.flags |= CAP_F_FALLBACK;
+        flash_note_dark_retake();
+        esp_camera_fb_return(fb);
+        fb = nullptr;
+        apply_lowlight_boost(true);
+        boosted = true;
+        scene = QCTL_SCENE_LOWLIGHT;
+        qctl_before_capture(scene);
+        discard_frames(3);
+        fb = camera_grab();
+        mark(tr, CAP_STAGE_FALLBACK, t);
+        if (!fb) return CR_FRAME_GRAB_FAIL;
+        qctl_after_capture(scene, fb->len);
+    }
+    tr.frame_len = fb->len;
+
+    // 5) 落盘：画面无变化时跳过SD写入
+    char photoFile[64] = {0};
+    bool unchanged = false;
+    if (opt.persist) {
+        unchanged = opt.change_detect && !cd_frame_changed(fb->buf, fb->len);
+        bool ok = true;
+        if (unchanged) tr.flags |= CAP_F_UNCHANGED;
+        else ok = save_frame_to_sd_with_name(fb, photoFile, sizeof(photoFile));
+        mark(tr, CAP_STAGE_PERSIST, t);
+        if (!ok) return CR_SD_SAVE_FAIL;
+        if (!unchanged && opt.change_detect) cd_commit_reference();
+    }
+
+    // 6) 分析 + 通知
+    if (opt.analyze && water_level_analyze_jpeg(fb->buf, fb->len)) tr.flags |= CAP_F_WL_FOUND;
+    if (opt.upload && opt.persist) {
+        if (unchanged) publish_meta_only(opt.trigger);
+        else capture_publish_for_upload(photoFile, opt.trigger);
+        tr.flags |= CAP_F_PUBLISHED;
+    }
+    mark(tr, CAP_STAGE_NOTIFY, t);
+    return CR_OK;
+}
+
+// 仅测量（不落盘）的运行不计入拍照次数
+static void update_run_stats(const CaptureOptions& opt, const CaptureTrace& tr) {
+    switch (tr.result) {
+        case CR_OK:
+            if (opt.persist) {
+                g_stats.total_captures++;
+                g_stats.last_capture_ms = millis();
+                if (!(tr.flags & CAP_F_UNCHANGED)) g_stats.consecutive_sd_fail = 0;
+            }
+            g_stats.last_frame_size = tr.frame_len;
+            g_stats.consecutive_capture_fail = 0;
+            break;
+        case CR_SD_SAVE_FAIL:
+            // 取帧本身成功，相机正常
+            g_stats.consecutive_capture_fail = 0;
+            g_stats.consecutive_sd_fail++;
+            break;
+        default:
+            g_stats.consecutive_capture_fail++;
+            break;
+    }
+}
+
+uint8_t capture_pipeline_run(const CaptureOptions& opt) {
+    CaptureTrace tr;
+    memset(&tr, 0, sizeof(tr));
+    tr.seq = ++s_seq;
+    tr.trigger = opt.trigger;
+    tr.t_start_us = esp_timer_get_time();
+
+    camera_fb_t* fb = nullptr;
+    bool boosted = false;
+    tr.result = run_stages(opt, tr, fb, boosted);
+
+    // 统一收尾
+    flashOff();
+    if (fb) esp_camera_fb_return(fb);
+    if (boosted) apply_lowlight_boost(false);
+    qctl_apply_pending_reinit();   // fb 已归还，可以安全重初始化
+    tr.total_us = (uint32_t)(esp_timer_get_time() - tr.t_start_us);
+
+    s_traces[s_trace_head] = tr;
+    s_trace_head = (s_trace_head + 1) % CAP_TRACE_DEPTH;
+    if (s_trace_count < CAP_TRACE_DEPTH) s_trace_count++;
+    update_run_stats(opt, tr);
+
+#if ENABLE_STATS_LOG && ENABLE_LOG2
+    Serial2.printf("[CAP] #%lu rc=%u total=%luus", (unsigned long)tr.seq, tr.result, (unsigned long)tr.total_us);
+    for (int i = 0; i < CAP_STAGE_COUNT; i++) {
+        Serial2.printf(" %s=%lu", STAGE_NAMES[i], (unsigned long)tr.stage_us[i]);
+    }
+    Serial2.println();
+#endif
+    return tr.result;
+}
+
+uint32_t capture_trace_count() { return s_trace_count; }
+
+bool capture_trace_get(uint32_t age, CaptureTrace& out) {
+    if (age >= s_trace_count) return false;
+    uint32_t idx = (s_trace_head + CAP_TRACE_DEPTH - 1 - age) % CAP_TRACE_DEPTH;
+    out = s_traces[idx];
+    return true;
+}
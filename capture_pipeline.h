@@ -0,0 +1,58 @@
+#pragma once
+#include <Arduino.h>
+#include "esp_camera.h"
+#include "config.h"
+
+// 拍照流水线阶段
+enum CaptureStage {
+    CAP_STAGE_WARMUP = 0,   // 开灯预热 + 丢帧收敛
+    CAP_STAGE_GRAB,         // 取帧
+    CAP_STAGE_QCHECK,       // 暗场判定
+    CAP_STAGE_FALLBACK,     // 关灯提亮重拍
+    CAP_STAGE_PERSIST,      // 变化检测 + 落盘
+    CAP_STAGE_NOTIFY,       // 水位分析 + 上传通知
+    CAP_STAGE_COUNT
+};
+
+// 跟踪标志
+#define CAP_F_FALLBACK   0x01   // 走了暗场回退
+#define CAP_F_UNCHANGED  0x02   // 画面无变化，未落盘
+#define CAP_F_PUBLISHED  0x04   // 已通知上传
+#define CAP_F_WL_FOUND   0x08   // 水位分析找到了水线
+
+struct CaptureOptions {
+    uint8_t trigger;
+    bool    warmup;          // 开灯预热+丢帧
+    bool    dark_fallback;   // 暗场时关灯重拍
+    bool    persist;         // 保存到SD
+    bool    change_detect;   // 保存前做变化检测
+    bool    analyze;         // 水位分析
+    bool    upload;          // 保存成功后通知上传
+};
+
+// 一次拍照的分阶段耗时（us，esp_timer）
+struct CaptureTrace {
+    uint32_t seq;
+    uint8_t  trigger;
+    uint8_t  result;                     // CR_*
+    uint8_t  flags;                      // CAP_F_*
+    uint32_t frame_len;
+    int64_t  t_start_us;
+    uint32_t stage_us[CAP_STAGE_COUNT];
+    uint32_t total_us;
+};
+
+// 常规拍照的默认选项（预热、暗场回退、变化检测、落盘、水位分析）
+void capture_default_options(CaptureOptions& o, uint8_t trigger, bool upload);
+
+// 运行一次流水线，返回 CR_*；同时维护 g_stats 与跟踪环
+uint8_t capture_pipeline_run(const CaptureOptions& opt);
+
+// 最近的拍照跟踪：age=0 为最新
+uint32_t capture_trace_count();
+bool capture_trace_get(uint32_t age, CaptureTrace& out);
+const char* capture_stage_name(CaptureStage st);
+
+// 供连拍复用的阶段
+void capture_stage_warmup();
+void capture_publish_for_upload(const char* photoFile, uint8_t trigger);
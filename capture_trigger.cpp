@@ -1,145 +1,143 @@
-#include "capture_trigger.h"
-#include "flash_module.h"
-#include "camera_module.h"
-#include "sdcard_module.h"
-#include "rtc_soft.h"
-#include "config.h"
-#include <string.h>
-
-// 来自 main.ino 的事件上传标志
-extern volatile int g_monitorEventUploadFlag;
-
-// 全局保存最后一张照片的文件名（上传用）
-char g_lastPhotoName[64] = {0};
-
-// 依据JPEG长度的“暗场”近似判定（补光被遮挡/光照很暗时，JPEG更小）
-static inline bool is_dark_jpeg(size_t jpeg_len) {
-    // 经验阈值：SVGA在极暗场常<16~18KB，可按需在config.h中调参
-    const size_t TH = JPEG_LEN_DARK_THRESH; // 默认16000
-    return jpeg_len > 0 && jpeg_len < TH;
-}
-
-// 低照度短时提升：用于重拍前提亮（关灯重拍时使用）
-static void apply_lowlight_boost(bool enable) {
-    sensor_t *s = esp_camera_sensor_get();
-    if (!s) return;
-    if (enable) {
-        s->set_aec2(s, 1);
-        s->set_ae_level(s, 2);                    // 曝光偏置拉高
-        s->set_gain_ctrl(s, 1);
-        s->set_gainceiling(s, (gainceiling_t)4);  // 放宽增益上限
-        s->set_brightness(s, 1);
-        // AWB继续开，避免强偏色
-        s->set_whitebal(s, 1);
-        s->set_awb_gain(s, 1);
-    } else {
-        // 回到默认偏保守的水平，避免后续过曝/偏色
-        s->set_ae_level(s, 0);
-        s->set_gainceiling(s, (gainceiling_t)3);
-        s->set_brightness(s, 1);
-        s->set_whitebal(s, 1);
-        s->set_awb_gain(s, 1);
-    }
-}
-
-static void warmup_with_flash_and_discard() {
-    flashOn();
-    delay(FLASH_WARM_MS);
-    if (DISCARD_FRAMES_EACH_SHOT > 0) {
-        discard_frames(DISCARD_FRAMES_EACH_SHOT);
-    }
-}
-
-uint8_t capture_once_internal(uint8_t trigger) {
-    if (!camera_ok) return CR_CAMERA_NOT_READY;
-
-    // 1) 常规路径：开灯预热 + 丢帧收敛
-    warmup_with_flash_and_discard();
-
-    camera_fb_t *fb = esp_camera_fb_get();
-    if (!fb) { flashOff(); return CR_FRAME_GRAB_FAIL; }
-
-    bool need_fallback = is_dark_jpeg(fb->len); // 补光被遮/极暗判定
-    bool ok = false;
-
-    if (!need_fallback) {
-        ok = save_frame_to_sd(fb, 0);
-        flashOff();
-        esp_camera_fb_return(fb);
-        return ok ? CR_OK : CR_SD_SAVE_FAIL;
-    }
-
-    // 2) 回退路径：暗 -> 关灯 + 提升曝光/增益 + 丢帧后重拍
-    esp_camera_fb_return(fb);
-    flashOff();
-
-    apply_lowlight_boost(true);
-    discard_frames(3);
-    camera_fb_t *fb2 = esp_camera_fb_get();
-    if (!fb2) {
-        apply_lowlight_boost(false);
-        return CR_FRAME_GRAB_FAIL;
-    }
-    ok = save_frame_to_sd(fb2, 0);
-    esp_camera_fb_return(fb2);
-    apply_lowlight_boost(false);
-
-    return ok ? CR_OK : CR_SD_SAVE_FAIL;
-}
-
-// 拍照保存与上传解耦：保存到SD并记录文件名，上传由 upload_manager 触发
-bool capture_and_process(uint8_t trigger, bool upload) {
-    if (!camera_ok) return false;
-
-    // 1) 常规路径：开灯预热 + 丢帧收敛
-    warmup_with_flash_and_discard();
-
-    camera_fb_t *fb = esp_camera_fb_get();
-    if (!fb) { flashOff(); return false; }
-
-    bool need_fallback = is_dark_jpeg(fb->len);
-    bool sdOk = false;
-
-    if (!need_fallback) {
-        char photoFile[64] = {0};
-        sdOk = save_frame_to_sd_with_name(fb, photoFile, sizeof(photoFile));
-        flashOff();
-
-        if (upload && sdOk) {
-            strncpy(g_lastPhotoName, photoFile, sizeof(g_lastPhotoName) - 1);
-            g_lastPhotoName[sizeof(g_lastPhotoName)-1] = '\0';
-            g_monitorEventUploadFlag = 1; // 通知上传管理器
-        }
-
-        esp_camera_fb_return(fb);
-        return sdOk;
-    }
-
-    // 2) 回退路径：暗 -> 关灯 + 提升曝光/增益 + 丢帧后重拍
-    esp_camera_fb_return(fb);
-    flashOff();
-
-    apply_lowlight_boost(true);
-    discard_frames(3);
-    camera_fb_t *fb2 = esp_camera_fb_get();
-    if (!fb2) {
-        apply_lowlight_boost(false);
-        return false;
-    }
-
-    char photoFile2[64] = {0};
-    sdOk = save_frame_to_sd_with_name(fb2, photoFile2, sizeof(photoFile2));
-    esp_camera_fb_return(fb2);
-    apply_lowlight_boost(false);
-
-    if (upload && sdOk) {
-        strncpy(g_lastPhotoName, photoFile2, sizeof(g_lastPhotoName) - 1);
-        g_lastPhotoName[sizeof(g_lastPhotoName)-1] = '\0';
-        g_monitorEventUploadFlag = 1; // 通知上传管理器
-    }
-    return sdOk;
-}
-
-void load_params_from_nvs() {
-    // TODO: 实现从NVS读取参数的逻辑。暂时空实现防止链接错误。
+#include "capture_trigger.h"
+#include "flash_module.h"
+#include "camera_module.h"
+#include "sdcard_module.h"
+#include "rtc_soft.h"
+#include "sd_async.h"
+#include "burst_ring.h"
+#include "jpeg_quality_ctl.h"
+#include "capture_pipeline.h"
+#include "image_store.h"
+#include "config.h"
+#include <string.h>
+
+// 全局保存最后一张照片的文件名（上传用）
+char g_lastPhotoName[64] = {0};
+// 最后一张待上传照片的触发条件
+uint8_t g_lastTriggerCond = TRIGGER_BUTTON;
+// 最近事件画面无变化：只上传元数据（g_lastPhotoName 为空）
+bool g_lastEventMetaOnly = false;
+
+uint8_t capture_once_internal(uint8_t trigger) {
+    CaptureOptions opt;
+    capture_default_options(opt, trigger, false);
+    return capture_pipeline_run(opt);
+}
+
+// 拍照保存与上传解耦：保存到SD并记录文件名，上传由 upload_manager 触发
+bool capture_and_process(uint8_t trigger, bool upload) {
+    CaptureOptions opt;
+    capture_default_options(opt, trigger, upload);
+    return capture_pipeline_run(opt) == CR_OK;
+}
+
+// 连拍清单：逐帧记录文件名与抓帧时间（相对首帧ms + RTC秒），与照片同目录
+static void write_burst_manifest(uint8_t trigger) {
+    BurstFrame* first = burst_ring_at(0);
+    if (!first || !first->name[0]) return;
+
+    char path[72];
+    uint32_t id;
+    if (image_store_parse_name(first->name, &id)) {
+        // 容器内图片没有目录，清单放容器目录
+        snprintf(path, sizeof(path), "%s/burst_%lu.csv", IMGSTORE_DIR, (unsigned long)id);
+    } else {
+        strncpy(path, first->name, sizeof(path) - 1);
+        path[sizeof(path) - 1] = '\0';
+        char* dot = strrchr(path, '.');
+        if (dot) *dot = '\0';
+        strncat(path, "_burst.csv", sizeof(path) - strlen(path) - 1);
+    }
+
+    static char text[96 + BURST_RING_SLOTS * 96];
+    size_t n = snprintf(text, sizeof(text), "trigger,%u\nidx,name,t_ms,dt_ms,epoch,len\n", (unsigned)trigger);
+    for (uint32_t i = 0; i < burst_ring_count() && n < sizeof(text); i++) {
+        BurstFrame* f = burst_ring_at(i);
+        n += snprintf(text + n, sizeof(text) - n, "%lu,%s,%lu,%lu,%lu,%lu\n",
+                      (unsigned long)i, f->name[0] ? f->name : "-",
+                      (unsigned long)f->t_ms, (unsigned long)(f->t_ms - first->t_ms),
+                      (unsigned long)f->epoch, (unsigned long)f->len);
+    }
+    if (n > sizeof(text)) n = sizeof(text);
+    if (!sd_async_submit(path, (const uint8_t*)text, n)) {
+        File fw = SD.open(path, FILE_WRITE);
+        if (fw) { fw.write((const uint8_t*)text, n); fw.close(); }
+    }
+}
+
+// 连拍：按固定节拍抓 frames 帧进PSRAM环形槽，期间不做任何SD操作；
+// 全部抓完、关灯后再逐帧交给 sd_async 持久化，避免SD延迟打乱抓帧节拍
+bool capture_burst(uint8_t trigger, uint8_t frames, uint32_t interval_ms, bool upload) {
+    if (!camera_ok) return false;
+    if (!burst_ring_init()) {
+        // 无PSRAM可用：退化为单拍
+        return capture_and_process(trigger, upload);
+    }
+    burst_ring_reset();
+    if (frames == 0) frames = 1;
+    if (frames > burst_ring_capacity()) frames = (uint8_t)burst_ring_capacity();
+
+    // 1) 连拍：一次预热，帧间只抓帧+复制
+    qctl_before_capture(QCTL_SCENE_FLASH);
+    capture_stage_warmup();
+    uint32_t next = millis();
+    for (uint8_t i = 0; i < frames; i++) {
+        int32_t wait = (int32_t)(next - millis());
+        if (wait > 0) delay(wait);
+        next += interval_ms;
+
+        camera_fb_t *fb = camera_grab();
+        if (!fb) continue;
+        uint32_t t_ms = millis();
+        qctl_after_capture(QCTL_SCENE_FLASH, fb->len);
+        if (!burst_ring_push(fb->buf, fb->len, t_ms, rtc_now())) {
+#if ENABLE_LOG2
+            Serial2.println("[BURST] Frame too large for slot, dropped.");
+#endif
+        }
+        esp_camera_fb_return(fb);
+    }
+    flashOff();
+    qctl_apply_pending_reinit();
+
+    // 2) 延迟持久化
+    uint32_t saved = 0;
+    for (uint32_t i = 0; i < burst_ring_count(); i++) {
+        BurstFrame* f = burst_ring_at(i);
+        if (save_buffer_to_sd_with_name(f->data, f->len, f->name, sizeof(f->name))) saved++;
+    }
+    if (saved == 0) return false;
+    write_burst_manifest(trigger);
+
+    // 上传首帧（最接近触发时刻），其余保留在SD
+    if (upload) {
+        for (uint32_t i = 0; i < burst_ring_count(); i++) {
+            BurstFrame* f = burst_ring_at(i);
+            if (f->name[0]) { capture_publish_for_upload(f->name, trigger); break; }
+        }
+    }
+#if ENABLE_LOG2
+    Serial2.print("[BURST] Saved frames: ");
+    Serial2.print(saved);
+    Serial2.print("/");
+    Serial2.println(burst_ring_count());
+#endif
+    return true;
+}
+
+// 仅测量不保存：与常规拍照相同的预热/取帧，帧交给水位核后直接归还
+bool capture_measure_frame() {
+    CaptureOptions opt;
+    capture_default_options(opt, 0, false);
+    opt.dark_fallback = false;
+    opt.persist = false;
+    opt.change_detect = false;
+    if (capture_pipeline_run(opt) != CR_OK) return false;
+    // 返回水位分析结果（未找到水线为false）
+    CaptureTrace tr;
+    return capture_trace_get(0, tr) && (tr.flags & CAP_F_WL_FOUND);
+}
+
+void load_params_from_nvs() {
+    // TODO: 实现从NVS读取参数的逻辑。暂时空实现防止链接错误。
 }
\ No newline at end of file
@@ -1,19 +1,29 @@
-#pragma once
-#include <Arduino.h>
-#include <Preferences.h>
-#include "esp_camera.h"
-
-// 新增：最后一张照片的文件名（供上传用）
-extern char g_lastPhotoName[64];
-
-// 新增参数：是否上传
-bool capture_and_process(uint8_t trigger, bool upload);
-
-uint8_t capture_once_internal(uint8_t trigger);
-// 保留旧接口，便于兼容
-inline bool capture_and_process(uint8_t trigger) { return capture_and_process(trigger, false); }
-
-void wait_button_release_on_boot();
-void save_params_to_nvs();
-void load_params_from_nvs();
+#pragma once
+#include <Arduino.h>
+#include <Preferences.h>
+#include "esp_camera.h"
+
+// 新增：最后一张照片的文件名（供上传用）
+extern char g_lastPhotoName[64];
+// 最后一张待上传照片的触发条件（事件上传 triggerCond）
+extern uint8_t g_lastTriggerCond;
+// 最近事件画面无变化，只上传元数据
+extern bool g_lastEventMetaOnly;
+
+// 新增参数：是否上传
+bool capture_and_process(uint8_t trigger, bool upload);
+
+uint8_t capture_once_internal(uint8_t trigger);
+
+// 连拍：按 interval_ms 抓 frames 帧进PSRAM环形槽，结束后统一异步落盘；upload=true时上传首帧
+bool capture_burst(uint8_t trigger, uint8_t frames, uint32_t interval_ms, bool upload);
+
+// 只取帧做水位测量，不保存不上传；返回水位分析结果
+bool capture_measure_frame();
+// 保留旧接口，便于兼容
+inline bool capture_and_process(uint8_t trigger) { return capture_and_process(trigger, false); }
+
+void wait_button_release_on_boot();
+void save_params_to_nvs();
+void load_params_from_nvs();
 // 可选：#define TRIGGER_BUTTON 1 (config.h 已定义)
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "change_detect.h"
+#include "jpeg_tools.h"
+#include "uart_utils.h"
+#include <string.h>
+
+static uint8_t  s_ref[CD_GRID_W * CD_GRID_H];
+static uint8_t  s_cur[CD_GRID_W * CD_GRID_H];
+static bool     s_has_ref = false;
+static bool     s_cur_valid = false;
+static uint32_t s_ref_ms = 0;
+static ChangeDetectStats s_stats = {0, 0, 0, 0, 0};
+
+// 网格均值签名
+static bool compute_signature(const uint8_t* jpg, size_t len, uint8_t* sig) {
+    JpegImage img;
+    if (!jpeg_decode_scaled(jpg, len, JPG_SCALE_8X, true, &img)) return false;
+    if (img.w < CD_GRID_W || img.h < CD_GRID_H) { jpeg_image_free(&img); return false; }
+
+    const uint16_t cw = img.w / CD_GRID_W;
+    const uint16_t ch = img.h / CD_GRID_H;
+    uint32_t sums[CD_GRID_W];
+    for (uint16_t gy = 0; gy < CD_GRID_H; gy++) {
+        memset(sums, 0, sizeof(sums));
+        for (uint16_t y = gy * ch; y < (gy + 1) * ch; y++) {
+            const uint8_t* row = img.px + (size_t)y * img.w;
+            for (uint16_t gx = 0; gx < CD_GRID_W; gx++) {
+                const uint8_t* p = row + gx * cw;
+                uint32_t s = 0;
+                for (uint16_t x = 0; x < cw; x++) s += p[x];
+                sums[gx] += s;
+            }
+        }
+        for (uint16_t gx = 0; gx < CD_GRID_W; gx++) {
+            sig[gy * CD_GRID_W + gx] = (uint8_t)(sums[gx] / ((uint32_t)cw * ch));
+        }
+    }
+    jpeg_image_free(&img);
+    return true;
+}
+
+bool cd_frame_changed(const uint8_t* jpg, size_t len) {
+#if CD_ENABLE
+    uint32_t t0 = micros();
+    s_stats.checks++;
+    s_cur_valid = compute_signature(jpg, len, s_cur);
+    s_stats.last_cost_us = micros() - t0;
+    if (!s_cur_valid || !s_has_ref) return true;
+    if (millis() - s_ref_ms >= CD_FORCE_STORE_MS) return true;   // 定期强制留一张
+
+    // 先扣除整体亮度偏移（补光/自动曝光波动），再比较局部差异
+    const int N = CD_GRID_W * CD_GRID_H;
+    int32_t bias = 0;
+    for (int i = 0; i < N; i++) bias += (int32_t)s_cur[i] - (int32_t)s_ref[i];
+    bias /= N;
+
+    uint32_t sum = 0, cells = 0;
+    for (int i = 0; i < N; i++) {
+        int32_t d = (int32_t)s_cur[i] - (int32_t)s_ref[i] - bias;
+        if (d < 0) d = -d;
+        sum += (uint32_t)d;
+        if (d > CD_CELL_THRESH) cells++;
+    }
+    s_stats.last_diff_q4 = (sum << 4) / N;
+    s_stats.last_cells = cells;
+
+    bool changed = (s_stats.last_diff_q4 > (CD_MEAN_THRESH << 4)) || (cells > CD_MAX_CHANGED_CELLS);
+    if (!changed) {
+        s_stats.unchanged++;
+        log2("[CD] Scene unchanged.");
+    }
+    return changed;
+#else
+    (void)jpg; (void)len;
+    return true;
+#endif
+}
+
+void cd_commit_reference() {
+#if CD_ENABLE
+    if (!s_cur_valid) return;
+    memcpy(s_ref, s_cur, sizeof(s_ref));
+    s_has_ref = true;
+    s_ref_ms = millis();
+#endif
+}
+
+void cd_get_stats(ChangeDetectStats& out) { out = s_stats; }
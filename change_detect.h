@@ -0,0 +1,24 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// 紧凑画面签名：1/8缩放解码（只用DCT直流分量，速度快）后的亮度网格均值
+#define CD_GRID_W 16
+#define CD_GRID_H 12
+
+struct ChangeDetectStats {
+    uint32_t checks;
+    uint32_t unchanged;       // 判定为无变化（未落盘、只发元数据）的次数
+    uint32_t last_diff_q4;    // 最近一次平均差（Q4亮度单位）
+    uint32_t last_cells;      // 最近一次变化格数
+    uint32_t last_cost_us;
+};
+
+// 与上次“已保存帧”的签名比较；返回 true 表示画面有变化（应保存）。
+// 无参考、解码失败或距上次保存超过 CD_FORCE_STORE_MS 时一律视为有变化
+bool cd_frame_changed(const uint8_t* jpg, size_t len);
+
+// 本帧已保存：把刚计算的签名设为新参考
+void cd_commit_reference();
+
+void cd_get_stats(ChangeDetectStats& out);
@@ -0,0 +1,25 @@
+#pragma once
+#include <stdint.h>
+
+// 公历日期 <-> 1970-01-01 起的天数，常数时间（按400年周期换算，3月为年首使闰日落在年末）。
+// 纯函数、不依赖 Arduino，主机测试见 test/rtc_civil_test.cpp
+static inline int32_t days_from_civil(int32_t y, uint32_t m, uint32_t d) {
+    y -= m <= 2;
+    const int32_t era = (y >= 0 ? y : y - 399) / 400;
+    const uint32_t yoe = (uint32_t)(y - era * 400);                    // [0, 399]
+    const uint32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1; // [0, 365]
+    const uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;        // [0, 146096]
+    return era * 146097 + (int32_t)doe - 719468;
+}
+
+static inline void civil_from_days(int32_t z, int32_t* y, uint32_t* m, uint32_t* d) {
+    z += 719468;
+    const int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const uint32_t doe = (uint32_t)(z - era * 146097);                         // [0, 146096]
+    const uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365; // [0, 399]
+    const uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);              // [0, 365]
+    const uint32_t mp = (5 * doy + 2) / 153;                                    // [0, 11]
+    *d = doy - (153 * mp + 2) / 5 + 1;
+    *m = mp < 10 ? mp + 3 : mp - 9;
+    *y = (int32_t)yoe + era * 400 + (*m <= 2);
+}
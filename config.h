@@ -1,217 +1,710 @@
-#pragma once
-#include <stdint.h>  // for uint32_t
-#include <stddef.h>  // for size_t
-#include <Arduino.h>
-#include "esp_camera.h"
-
-// ================== 现有配置 ==================
-#define ENABLE_LOG2 0 // 日志和串口2总开关，0为全部屏蔽，1为全部开启
-
-#define SERVER_IP   "47.104.5.75"
-#define SERVER_PORT 9909
-
-#if ENABLE_LOG2
-#define TX2         15
-#define RX2         13
-#endif
-
-#define DTU_BAUD    115200
-#define LOG_BAUD    115200
-
-#define PLATFORM_VER        0x5b
-#define PLATFORM_DMODEL     0x1d
-#define CMD_HEARTBEAT_REQ   0x0000
-#define CMD_TIME_SYNC_REQ   0x0001
-
-static char g_device_sn[13] = "000000065531";
-
-// Time constants (ms)
-static const uint32_t AT_TIMEOUT_MS        = 3000;
-static const uint32_t REG_TIMEOUT_MS       = 8000;
-static const uint32_t OPEN_TIMEOUT_MS      = 15000;
-static const uint32_t STATE_POLL_MS        = 10000;
-static const uint32_t HEARTBEAT_INTERVAL_MS = 60000;
-static const uint32_t BACKOFF_MAX_MS = 30000;
-static const uint32_t REALTIME_UPLOAD_INTERVAL_MS = 30000;
-
-// RTC校时周期（10分钟）
-static const uint32_t TIME_SYNC_INTERVAL_MS = 600000; // 10min
-
-static const size_t LINE_BUF_MAX = 512;
-
-extern volatile int g_monitorEventUploadFlag;
-
-#define SW_VER_HIGH  1
-#define SW_VER_MID   1
-#define SW_VER_LOW   1
-
-#define HW_VER_HIGH  1
-#define HW_VER_MID   1
-#define HW_VER_LOW   1
-
-// 20字节产品型号，末尾补0
-#define PRODUCT_MODEL_STR "MODEL-TEST"
-
-
-// ===== 异步SD写与内存池（务必放在最前，确保其它头文件引用这些宏时已定义）=====
-#ifndef ASYNC_SD_ENABLE
-#define ASYNC_SD_ENABLE 1
-#endif
-
-#ifndef ASYNC_SD_POOL_BLOCK_SIZE
-#define ASYNC_SD_POOL_BLOCK_SIZE (256 * 1024)
-#endif
-
-#ifndef ASYNC_SD_POOL_BLOCKS
-#define ASYNC_SD_POOL_BLOCKS 3
-#endif
-
-#ifndef ASYNC_SD_QUEUE_LENGTH
-#define ASYNC_SD_QUEUE_LENGTH 8
-#endif
-
-#ifndef ASYNC_SD_TASK_STACK
-#define ASYNC_SD_TASK_STACK 4096
-#endif
-
-#ifndef ASYNC_SD_TASK_PRIO
-#define ASYNC_SD_TASK_PRIO 3
-#endif
-
-#ifndef ASYNC_SD_MAX_PATH
-#define ASYNC_SD_MAX_PATH 96
-#endif
-
-#ifndef ASYNC_SD_SUBMIT_TIMEOUT_MS
-#define ASYNC_SD_SUBMIT_TIMEOUT_MS 50
-#endif
-
-#ifndef ASYNC_SD_FLUSH_TIMEOUT_MS
-#define ASYNC_SD_FLUSH_TIMEOUT_MS 5000
-#endif
-// ===== 异步SD写与内存池 END =====
-
-// === 开关 ===
-#define UPGRADE_ENABLE 1
-
-// === 基本参数 ===
-#define SERIAL_BAUD                    115200
-
-// 提升补光占空/预热时长（遮挡时会自动回退，无副作用）
-#define DEFAULT_FLASH_DUTY             120
-#define FLASH_WARM_MS                  80
-
-// 分辨率/画质：数值越小画质越高（文件更大）
-#define FRAME_SIZE_PREF                FRAMESIZE_SVGA
-#define FRAME_SIZE_FALLBACK            FRAMESIZE_VGA
-#define JPEG_QUALITY_PREF              8
-#define JPEG_QUALITY_FALLBACK          12
-
-#define INIT_RETRY_PER_CONFIG          3
-#define RUNTIME_FAIL_REINIT_THRESHOLD  3
-#define CAPTURE_FAIL_REBOOT_THRESHOLD  10
-#define SD_FAIL_REBOOT_THRESHOLD       10
-#define HEAP_MIN_REBOOT                10000
-#define SD_MIN_FREE_MB                 5
-
-// 上电后丢帧，促使AWB/AE收敛
-#define DISCARD_FRAMES_ON_START        3
-// 每次拍照前在补光开启条件下丢弃的帧数（强烈建议>=3）
-#define DISCARD_FRAMES_EACH_SHOT       5
-
-#define ENABLE_AUTO_REINIT             1
-#define ENABLE_STATS_LOG               1
-#define ENABLE_FRAME_HEADER            0
-#define ENABLE_ASYNC_SD_WRITE          1
-#define SAVE_PARAMS_INTERVAL_IMAGES    50
-#define DEFAULT_SEND_BEFORE_SAVE       1
-#define FLASH_MODE                     1
-#define FLASH_ON_TIME_MS_DIGITAL       40
-#define HEAP_WARN_THRESHOLD            16000
-#define HEAP_LARGEST_BLOCK_WARN        12000
-static constexpr uint32_t NVS_MIN_SAVE_INTERVAL_MS = 60UL * 1000UL;
-
-#ifndef PROTO_MIN_SEND_INTERVAL_MS
-#define PROTO_MIN_SEND_INTERVAL_MS 150  // 最小发送间隔(ms)，设置为0可完全关闭节流
-#endif
-
-// 按JPEG大小近似判断是否过暗的阈值（单位：字节）
-// 说明：在SVGA/VGA等小分辨率下，极暗场景通常产生更小的JPEG；可按实测微调
-#ifndef JPEG_LEN_DARK_THRESH
-#define JPEG_LEN_DARK_THRESH 16000
-#endif
-
-// === 引脚 ===
-#define PWDN_GPIO 32
-#define RESET_GPIO -1
-#define XCLK_GPIO 0
-#define SIOD_GPIO 26
-#define SIOC_GPIO 27
-#define Y9_GPIO 35
-#define Y8_GPIO 34
-#define Y7_GPIO 39
-#define Y6_GPIO 36
-#define Y5_GPIO 21
-#define Y4_GPIO 19
-#define Y3_GPIO 18
-#define Y2_GPIO 5
-#define VSYNC_GPIO 25
-#define HREF_GPIO 23
-#define PCLK_GPIO 22
-
-// SD Pins
-#define SD_CS   13
-#define SD_SCK  14
-#define SD_MISO 2
-#define SD_MOSI 15
-
-// Flash
-#define FLASH_PIN 4
-#if FLASH_MODE
-  #define FLASH_FREQ_HZ      5000
-  #define FLASH_RES_BITS     8
-  #define FLASH_TIMER        LEDC_TIMER_1
-  #define FLASH_SPEED_MODE   LEDC_LOW_SPEED_MODE
-  #define FLASH_CHANNEL      LEDC_CHANNEL_4
-#endif
-
-// Button
-#define BUTTON_PIN 12
-#define TRIGGER_BUTTON 1
-
-typedef struct {
-    bool saveEnabled;
-    bool sendEnabled;
-    bool asyncSDWrite;
-} RuntimeConfig;
-
-extern RuntimeConfig g_cfg;
-
-typedef struct {
-    uint32_t total_captures;
-    uint32_t last_frame_size;
-    uint32_t last_capture_ms;
-    uint32_t consecutive_capture_fail;
-    uint32_t consecutive_sd_fail;
-} RunStats;
-
-extern RunStats g_stats;
-
-// 拍照返回码
-#define CR_OK 0
-#define CR_CAMERA_NOT_READY 1
-#define CR_FRAME_GRAB_FAIL 2
-#define CR_SD_SAVE_FAIL 3
-
-// 升级相关占位
-typedef struct {
-    int state;
-} UpgradeState;
-#define UPG_DOWNLOADING 1
-#define UPG_FILE_INFO 2
-extern UpgradeState g_upg;
-extern bool g_debugMode;
-
-// 占位失败处理函数
-inline void handle_camera_failure() {}
-inline void handle_sd_failure() {}
\ No newline at end of file
+#pragma once
+#include <stdint.h>  // for uint32_t
+#include <stddef.h>  // for size_t
+#include <Arduino.h>
+#include "esp_camera.h"
+
+// ================== 现有配置 ==================
+#define ENABLE_LOG2 0 // 日志和串口2总开关，0为全部屏蔽，1为全部开启
+
+#define SERVER_IP   "47.104.5.75"
+#define SERVER_PORT 9909
+
+#if ENABLE_LOG2
+#define TX2         15
+#define RX2         13
+#endif
+
+#define DTU_BAUD    115200
+#define LOG_BAUD    115200
+
+#define PLATFORM_VER        0x5b
+#define PLATFORM_DMODEL     0x1d
+#define CMD_HEARTBEAT_REQ   0x0000
+#define CMD_TIME_SYNC_REQ   0x0001
+
+static char g_device_sn[13] = "000000065531";
+
+// Time constants (ms)
+static const uint32_t AT_TIMEOUT_MS        = 3000;
+static const uint32_t REG_TIMEOUT_MS       = 8000;
+static const uint32_t OPEN_TIMEOUT_MS      = 15000;
+static const uint32_t STATE_POLL_MS        = 10000;
+static const uint32_t HEARTBEAT_INTERVAL_MS = 60000;
+static const uint32_t BACKOFF_MAX_MS = 30000;
+static const uint32_t REALTIME_UPLOAD_INTERVAL_MS = 30000;
+
+// 校时请求的最小间隔（由 rtc_needs_sync 决定何时校时，未收到应答时按此间隔重发）
+static const uint32_t TIME_SYNC_RETRY_MS = 60000;
+
+static const size_t LINE_BUF_MAX = 512;
+
+extern volatile int g_monitorEventUploadFlag;
+
+#define SW_VER_HIGH  1
+#define SW_VER_MID   1
+#define SW_VER_LOW   1
+
+#define HW_VER_HIGH  1
+#define HW_VER_MID   1
+#define HW_VER_LOW   1
+
+// 20字节产品型号，末尾补0
+#define PRODUCT_MODEL_STR "MODEL-TEST"
+
+
+// ===== 异步SD写与内存池（务必放在最前，确保其它头文件引用这些宏时已定义）=====
+#ifndef ASYNC_SD_ENABLE
+#define ASYNC_SD_ENABLE 1
+#endif
+
+#ifndef ASYNC_SD_POOL_BLOCK_SIZE
+#define ASYNC_SD_POOL_BLOCK_SIZE (256 * 1024)   // 最大尺寸类
+#endif
+
+#ifndef ASYNC_SD_POOL_BLOCKS
+#define ASYNC_SD_POOL_BLOCKS 3                  // PSRAM预算 = 块数 x 最大块
+#endif
+
+// 尺寸类分配：在同样的预算内切成 16KB/64KB/256KB 三类块
+#ifndef ASYNC_SD_SLAB_SMALL_SIZE
+#define ASYNC_SD_SLAB_SMALL_SIZE (16 * 1024)
+#endif
+#ifndef ASYNC_SD_SLAB_SMALL_COUNT
+#define ASYNC_SD_SLAB_SMALL_COUNT 12
+#endif
+#ifndef ASYNC_SD_SLAB_MID_SIZE
+#define ASYNC_SD_SLAB_MID_SIZE (64 * 1024)
+#endif
+#ifndef ASYNC_SD_SLAB_MID_COUNT
+#define ASYNC_SD_SLAB_MID_COUNT 5
+#endif
+#ifndef ASYNC_SD_SLAB_LARGE_COUNT
+#define ASYNC_SD_SLAB_LARGE_COUNT 1
+#endif
+
+// 队列长度不小于总块数，保证所有块都能同时在途
+#ifndef ASYNC_SD_QUEUE_LENGTH
+#define ASYNC_SD_QUEUE_LENGTH (ASYNC_SD_SLAB_SMALL_COUNT + ASYNC_SD_SLAB_MID_COUNT + ASYNC_SD_SLAB_LARGE_COUNT)
+#endif
+
+#ifndef ASYNC_SD_TASK_STACK
+#define ASYNC_SD_TASK_STACK 4096
+#endif
+
+#ifndef ASYNC_SD_TASK_PRIO
+#define ASYNC_SD_TASK_PRIO 3
+#endif
+
+#ifndef ASYNC_SD_MAX_PATH
+#define ASYNC_SD_MAX_PATH 96
+#endif
+
+#ifndef ASYNC_SD_SUBMIT_TIMEOUT_MS
+#define ASYNC_SD_SUBMIT_TIMEOUT_MS 50
+#endif
+
+#ifndef ASYNC_SD_FLUSH_TIMEOUT_MS
+#define ASYNC_SD_FLUSH_TIMEOUT_MS 5000
+#endif
+
+// 写合并块：4KB~32KB，须为512的整数倍（按扇区对齐突发写）
+#ifndef ASYNC_SD_WC_SIZE
+#define ASYNC_SD_WC_SIZE (16 * 1024)
+#endif
+
+// 文件句柄在无后续块时的空闲关闭时间
+#ifndef ASYNC_SD_IDLE_CLOSE_MS
+#define ASYNC_SD_IDLE_CLOSE_MS 500
+#endif
+
+// 开机写入基准的数据量（0=不测）。每次上电都会写删一个测试文件，只在调试时开启
+#ifndef ASYNC_SD_BENCH_BYTES
+#define ASYNC_SD_BENCH_BYTES 0
+#endif
+
+// 写日志（整文件写的意图/提交记录，掉电后开机隔离半截文件）
+#ifndef ASYNC_SD_JOURNAL_ENABLE
+#define ASYNC_SD_JOURNAL_ENABLE 1
+#endif
+#ifndef ASYNC_SD_JOURNAL_PATH
+#define ASYNC_SD_JOURNAL_PATH "/sdjournal.bin"
+#endif
+#ifndef ASYNC_SD_JOURNAL_MAX_BYTES
+#define ASYNC_SD_JOURNAL_MAX_BYTES (32 * 1024)   // 超过后在文件边界清空
+#endif
+#ifndef ASYNC_SD_JOURNAL_ORPHANS
+#define ASYNC_SD_JOURNAL_ORPHANS 8               // 轮转时带入新日志的未完成意图上限（满时最旧的一条当场检查隔离）
+#endif
+#ifndef ASYNC_SD_QUARANTINE_SUFFIX
+#define ASYNC_SD_QUARANTINE_SUFFIX ".part"
+#endif
+
+// 准入：后台写须给事件照片留出的池空间；池占用超过该百分比即报 HIGH 背压
+#ifndef ASYNC_SD_EVENT_RESERVE
+#define ASYNC_SD_EVENT_RESERVE (128 * 1024)
+#endif
+#ifndef ASYNC_SD_BP_HIGH_PCT
+#define ASYNC_SD_BP_HIGH_PCT 60
+#endif
+
+// 延迟直方图桶数（log2 微秒，24桶覆盖到约8秒）与滚动吞吐窗口
+#ifndef ASYNC_SD_HIST_BUCKETS
+#define ASYNC_SD_HIST_BUCKETS 24
+#endif
+#ifndef ASYNC_SD_RATE_WINDOW_S
+#define ASYNC_SD_RATE_WINDOW_S 10
+#endif
+
+// 异步读：同时进行的读流数、每块大小、每流最多预读块数
+#ifndef ASYNC_SD_READ_STREAMS
+#define ASYNC_SD_READ_STREAMS 2
+#endif
+#ifndef ASYNC_SD_READ_CHUNK
+#define ASYNC_SD_READ_CHUNK (16 * 1024)
+#endif
+#ifndef ASYNC_SD_READ_AHEAD
+#define ASYNC_SD_READ_AHEAD 2
+#endif
+
+// 小记录追加合并：合并槽数（每槽一个路径）、每槽缓冲（即按大小提交的阈值）、最长攒多久
+#ifndef ASYNC_SD_GROUP_SLOTS
+#define ASYNC_SD_GROUP_SLOTS 4
+#endif
+#ifndef ASYNC_SD_GROUP_BYTES
+#define ASYNC_SD_GROUP_BYTES 4096
+#endif
+#ifndef ASYNC_SD_GROUP_MAX_MS
+#define ASYNC_SD_GROUP_MAX_MS 10000
+#endif
+
+// 写队列满时暂缓入队的照片数（数据钉在写后读缓存中），超时仍放不下则同步写
+#ifndef SD_DEFER_MAX
+#define SD_DEFER_MAX 4
+#endif
+#ifndef SD_DEFER_MAX_MS
+#define SD_DEFER_MAX_MS 5000
+#endif
+// ===== 异步SD写与内存池 END =====
+
+// === 开关 ===
+#define UPGRADE_ENABLE 1
+
+// === 基本参数 ===
+#define SERIAL_BAUD                    115200
+
+// 提升补光占空/预热时长（遮挡时会自动回退，无副作用）
+#define DEFAULT_FLASH_DUTY             120
+#define FLASH_WARM_MS                  80
+
+// 分辨率/画质：数值越小画质越高（文件更大）
+#define FRAME_SIZE_PREF                FRAMESIZE_SVGA
+#define FRAME_SIZE_FALLBACK            FRAMESIZE_VGA
+#define JPEG_QUALITY_PREF              8
+#define JPEG_QUALITY_FALLBACK          12
+
+#define INIT_RETRY_PER_CONFIG          3
+#define RUNTIME_FAIL_REINIT_THRESHOLD  3
+#define CAPTURE_FAIL_REBOOT_THRESHOLD  10
+#define SD_FAIL_REBOOT_THRESHOLD       10
+#define HEAP_MIN_REBOOT                10000
+#define SD_MIN_FREE_MB                 5
+
+// 上电后丢帧，促使AWB/AE收敛
+#define DISCARD_FRAMES_ON_START        3
+// 每次拍照前在补光开启条件下丢弃的帧数（强烈建议>=3）
+#define DISCARD_FRAMES_EACH_SHOT       5
+
+#define ENABLE_AUTO_REINIT             1
+#define ENABLE_STATS_LOG               1
+#define CAP_TRACE_DEPTH                16   // 保留最近N次拍照的分阶段耗时
+#define ENABLE_FRAME_HEADER            0
+#define ENABLE_ASYNC_SD_WRITE          1
+#define SAVE_PARAMS_INTERVAL_IMAGES    50
+#define DEFAULT_SEND_BEFORE_SAVE       1
+#define FLASH_MODE                     1
+#define FLASH_ON_TIME_MS_DIGITAL       40
+#define HEAP_WARN_THRESHOLD            16000
+#define HEAP_LARGEST_BLOCK_WARN        12000
+static constexpr uint32_t NVS_MIN_SAVE_INTERVAL_MS = 60UL * 1000UL;
+
+#ifndef PROTO_MIN_SEND_INTERVAL_MS
+#define PROTO_MIN_SEND_INTERVAL_MS 150  // 最小发送间隔(ms)，设置为0可完全关闭节流
+#endif
+
+// 按JPEG大小近似判断是否过暗的阈值（单位：字节）
+// 说明：在SVGA/VGA等小分辨率下，极暗场景通常产生更小的JPEG；可按实测微调
+#ifndef JPEG_LEN_DARK_THRESH
+#define JPEG_LEN_DARK_THRESH 16000
+#endif
+
+// ===== 连拍（Burst）模式 =====
+// 连拍帧先复制进预分配的PSRAM环形槽，连拍结束后再统一交给 sd_async 持久化
+#ifndef BURST_FRAMES
+#define BURST_FRAMES 8                  // 每次连拍帧数（不超过槽位数）
+#endif
+
+#ifndef BURST_INTERVAL_MS
+#define BURST_INTERVAL_MS 200           // 帧间隔(ms)
+#endif
+
+#ifndef BURST_RING_SLOTS
+#define BURST_RING_SLOTS 8              // 环形槽位数
+#endif
+
+#ifndef BURST_SLOT_SIZE
+#define BURST_SLOT_SIZE (96 * 1024)     // 单槽容量，超长帧丢弃
+#endif
+
+#ifndef BURST_ON_BUTTON
+#define BURST_ON_BUTTON 0               // 1=长按按钮触发连拍而不是单拍
+#endif
+
+// ===== 上传缩略图（原图留在SD，上行只发缩小重编码后的版本）=====
+#ifndef THUMB_UPLOAD_ENABLE
+#define THUMB_UPLOAD_ENABLE 1           // 1=事件上传默认发送缩略图
+#endif
+
+#ifndef THUMB_MAX_BYTES
+#define THUMB_MAX_BYTES 24000           // 缩略图字节预算（须 ≤ 65000）
+#endif
+
+#ifndef THUMB_MIN_SCALE
+#define THUMB_MIN_SCALE JPG_SCALE_2X    // 起始缩放：JPG_SCALE_2X/4X/8X = 1/2、1/4、1/8
+#endif
+
+#ifndef THUMB_QUALITY_START
+#define THUMB_QUALITY_START 60          // 重编码画质（1..100，越大越好）
+#endif
+
+#ifndef THUMB_QUALITY_MIN
+#define THUMB_QUALITY_MIN 20
+#endif
+
+#ifndef THUMB_QUALITY_STEP
+#define THUMB_QUALITY_STEP 15
+#endif
+
+#ifndef THUMB_SRC_MAX_BYTES
+#define THUMB_SRC_MAX_BYTES (256 * 1024) // 可转码的原图上限
+#endif
+
+// ===== JPEG画质闭环（按近期帧大小调整 set_quality，逼近目标字节数）=====
+#ifndef QCTL_ENABLE
+#define QCTL_ENABLE 1
+#endif
+
+#ifndef QCTL_TARGET_BYTES
+#define QCTL_TARGET_BYTES 45000         // 单帧目标字节数
+#endif
+
+#ifndef QCTL_HARD_CAP_BYTES
+#define QCTL_HARD_CAP_BYTES 65000       // 上传上限，超过即计数告警
+#endif
+
+#ifndef QCTL_Q_MIN
+#define QCTL_Q_MIN 6                    // 允许的最好画质
+#endif
+
+#ifndef QCTL_Q_MAX
+#define QCTL_Q_MAX 30                   // 允许的最差画质
+#endif
+
+#ifndef QCTL_MAX_STEP
+#define QCTL_MAX_STEP 4                 // 单次最大调整量
+#endif
+
+#ifndef QCTL_EWMA_SHIFT
+#define QCTL_EWMA_SHIFT 2               // 滑动均值系数 1/4
+#endif
+
+#ifndef QCTL_BP_STEP
+#define QCTL_BP_STEP 6                  // SD写队列背压时临时加大的画质值（文件更小）
+#endif
+
+#ifndef QCTL_REINIT_AFTER
+#define QCTL_REINIT_AFTER 3             // 最差画质下连续超限N帧才降分辨率重初始化
+#endif
+
+// ===== 传感器开窗（ROI）：只读出水尺附近区域，1:1原生细节 =====
+// 坐标为 OV2640 全幅（UXGA 1600x1200）像素；输出尺寸须为4的倍数，
+// 且像素数不超过初始化分辨率（JPEG帧缓冲按其分配）
+#ifndef ROI_ENABLE
+#define ROI_ENABLE 0
+#endif
+
+#ifndef ROI_X
+#define ROI_X 600
+#endif
+
+#ifndef ROI_Y
+#define ROI_Y 200
+#endif
+
+#ifndef ROI_W
+#define ROI_W 400
+#endif
+
+#ifndef ROI_H
+#define ROI_H 800
+#endif
+
+#ifndef ROI_OUT_W
+#define ROI_OUT_W ROI_W                 // 与窗口相同即不缩放
+#endif
+
+#ifndef ROI_OUT_H
+#define ROI_OUT_H ROI_H
+#endif
+
+// ===== 水位识别（水尺ROI灰度图 -> 水线行 -> 水位mm）=====
+// 需现场标定 WL_ZERO_ROW / WL_MM_PER_PX_Q8 后开启
+#ifndef WL_ENABLE
+#define WL_ENABLE 0
+#endif
+
+#ifndef WL_DECODE_SCALE
+#define WL_DECODE_SCALE JPG_SCALE_4X    // 测量用解码缩放
+#endif
+
+#ifndef WL_ROI_X
+#define WL_ROI_X 0                      // 水尺区域（输出帧像素坐标），W/H为0表示整幅
+#endif
+
+#ifndef WL_ROI_Y
+#define WL_ROI_Y 0
+#endif
+
+#ifndef WL_ROI_W
+#define WL_ROI_W 0
+#endif
+
+#ifndef WL_ROI_H
+#define WL_ROI_H 0
+#endif
+
+#ifndef WL_GAUGE_COLS
+#define WL_GAUGE_COLS 8                 // 水尺带宽度（解码图列数）
+#endif
+
+#ifndef WL_MIN_CONTRAST_Q8
+#define WL_MIN_CONTRAST_Q8 384          // 水线上/下纹理比下限（Q8，384=1.5倍）
+#endif
+
+#ifndef WL_ZERO_ROW
+#define WL_ZERO_ROW 600                 // 水尺零点所在行（输出帧像素）
+#endif
+
+#ifndef WL_MM_PER_PX_Q8
+#define WL_MM_PER_PX_Q8 256             // 每像素对应mm（Q8，256=1mm）
+#endif
+
+#ifndef WL_THRESHOLD_MM
+#define WL_THRESHOLD_MM 300             // 告警水位
+#endif
+
+#ifndef WL_HYSTERESIS_MM
+#define WL_HYSTERESIS_MM 20             // 回落回差
+#endif
+
+#ifndef WL_LOG_ENABLE
+#define WL_LOG_ENABLE 1                 // 每次测量追加一行到 WL_LOG_PATH（小记录合并写）
+#endif
+
+#ifndef WL_LOG_PATH
+#define WL_LOG_PATH "/DCIM/wlevel.csv"
+#endif
+
+#ifndef WL_SAMPLE_INTERVAL_MS
+#define WL_SAMPLE_INTERVAL_MS 60000     // 定时测量周期
+#endif
+
+// ===== 画面变化检测（无变化不落盘、事件只发元数据）=====
+#ifndef CD_ENABLE
+#define CD_ENABLE 1
+#endif
+
+#ifndef CD_MEAN_THRESH
+#define CD_MEAN_THRESH 4                // 网格平均亮度差阈值（扣除整体偏移后）
+#endif
+
+#ifndef CD_CELL_THRESH
+#define CD_CELL_THRESH 16               // 单格亮度差超过此值记为“变化格”
+#endif
+
+#ifndef CD_MAX_CHANGED_CELLS
+#define CD_MAX_CHANGED_CELLS 4          // 变化格超过此数即判定有变化（捕捉局部变化）
+#endif
+
+#ifndef CD_FORCE_STORE_MS
+#define CD_FORCE_STORE_MS (60UL * 60UL * 1000UL) // 至少每小时保存一张
+#endif
+
+// ===== 运动监视触发（低分辨率灰度监视流 + 块差分）=====
+// 开启后传感器常驻QQVGA、每 MW_INTERVAL_MS 抓帧解码，功耗明显增加，按现场需要开启
+#ifndef MW_ENABLE
+#define MW_ENABLE 0
+#endif
+
+#ifndef MW_INTERVAL_MS
+#define MW_INTERVAL_MS 250              // 监视帧间隔
+#endif
+
+#ifndef MW_FRAME_SIZE
+#define MW_FRAME_SIZE FRAMESIZE_QQVGA   // 监视期间传感器分辨率
+#endif
+
+#ifndef MW_DECODE_SCALE
+#define MW_DECODE_SCALE JPG_SCALE_2X    // QQVGA按1/2解码为80x60灰度
+#endif
+
+#ifndef MW_BLOCK_THRESH
+#define MW_BLOCK_THRESH 12              // 8x8块平均绝对差阈值
+#endif
+
+#ifndef MW_MIN_BLOCKS
+#define MW_MIN_BLOCKS 3                 // 变化块数阈值
+#endif
+
+#ifndef MW_CONFIRM_FRAMES
+#define MW_CONFIRM_FRAMES 2             // 连续确认帧数
+#endif
+
+#ifndef MW_COOLDOWN_MS
+#define MW_COOLDOWN_MS 60000            // 触发后冷却时间
+#endif
+
+// ===== 补光自动标定（锁曝光逐级加占空比，记录达到目标亮度的最小占空比与预热时长）=====
+#ifndef FLASH_CAL_ENABLE
+#define FLASH_CAL_ENABLE 1
+#endif
+#ifndef FLASH_CAL_FRAME_SIZE
+#define FLASH_CAL_FRAME_SIZE FRAMESIZE_QVGA   // 探测帧分辨率
+#endif
+#ifndef FLASH_CAL_TARGET_LUMA
+#define FLASH_CAL_TARGET_LUMA 110             // 目标平均亮度（0~255）
+#endif
+#ifndef FLASH_CAL_MAX_AMBIENT
+#define FLASH_CAL_MAX_AMBIENT 40              // 关灯亮度高于此值说明环境光主导，不标定
+#endif
+#ifndef FLASH_CAL_DUTY_MIN
+#define FLASH_CAL_DUTY_MIN 24
+#endif
+#ifndef FLASH_CAL_DUTY_STEP
+#define FLASH_CAL_DUTY_STEP 16
+#endif
+#ifndef FLASH_CAL_AEC_VALUE
+#define FLASH_CAL_AEC_VALUE 300               // 标定期间固定曝光
+#endif
+#ifndef FLASH_CAL_AGC_GAIN
+#define FLASH_CAL_AGC_GAIN 4                  // 标定期间固定增益
+#endif
+#ifndef FLASH_CAL_SETTLE_PCT
+#define FLASH_CAL_SETTLE_PCT 95               // 亮度达到稳态的该百分比即视为预热完成
+#endif
+#ifndef FLASH_CAL_WARM_MIN_MS
+#define FLASH_CAL_WARM_MIN_MS 20
+#endif
+#ifndef FLASH_CAL_INTERVAL_MS
+#define FLASH_CAL_INTERVAL_MS (24UL * 3600UL * 1000UL)   // 定期重标定（镜头脏污/LED衰减）
+#endif
+#ifndef FLASH_CAL_RETRY_MS
+#define FLASH_CAL_RETRY_MS (3600UL * 1000UL)  // 环境过亮等失败后的重试间隔
+#endif
+#ifndef FLASH_CAL_DARK_RETAKES
+#define FLASH_CAL_DARK_RETAKES 3              // 累计暗场重拍达到此数提前重标定
+#endif
+
+// ===== 相机健康监督任务（取帧失败/耗时跟踪，后台重初始化，超限重启）=====
+#ifndef CAM_SUP_ENABLE
+#define CAM_SUP_ENABLE 1
+#endif
+#ifndef CAM_SUP_PERIOD_MS
+#define CAM_SUP_PERIOD_MS 1000             // 巡检周期
+#endif
+#ifndef CAM_SUP_TASK_STACK
+#define CAM_SUP_TASK_STACK 4096
+#endif
+#ifndef CAM_SUP_TASK_PRIO
+#define CAM_SUP_TASK_PRIO 2
+#endif
+#ifndef CAM_SUP_PROBE_IDLE_MS
+#define CAM_SUP_PROBE_IDLE_MS 60000        // 这么久没有取帧则由监督任务试取一帧
+#endif
+#ifndef CAM_SUP_STALL_REBOOT_MS
+#define CAM_SUP_STALL_REBOOT_MS 30000      // 单次取帧卡住超过此时长直接重启
+#endif
+#ifndef CAM_SUP_PREF_RETRY_MS
+#define CAM_SUP_PREF_RETRY_MS (6UL * 3600UL * 1000UL) // 初始化落在降级档时，隔多久再试优先档
+#endif
+#ifndef CAM_SUP_REBOOT_HANDOFF_MS
+#define CAM_SUP_REBOOT_HANDOFF_MS 3000     // 重启交给主循环执行（先落盘合并的追加记录），超时未执行则监督任务自己重启
+#endif
+#ifndef CAM_SUP_TREND_WINDOW_MS
+#define CAM_SUP_TREND_WINDOW_MS 60000      // 取帧耗时趋势的统计窗口
+#endif
+#ifndef CAM_SUP_TREND_DEPTH
+#define CAM_SUP_TREND_DEPTH 16             // 保留的窗口数
+#endif
+#ifndef CAM_LOCK_WAIT_MS
+#define CAM_LOCK_WAIT_MS 5000              // 按键拍照等待监督任务释放相机的上限
+#endif
+
+// ===== 图片容器存储（追加写大段文件+定长索引，替代每张照片一个FAT文件）=====
+#ifndef IMGSTORE_ENABLE
+#define IMGSTORE_ENABLE 0
+#endif
+#ifndef IMGSTORE_DIR
+#define IMGSTORE_DIR "/imgstore"
+#endif
+#ifndef IMGSTORE_SEG_SIZE
+#define IMGSTORE_SEG_SIZE (64UL * 1024UL * 1024UL)   // 每段预分配大小
+#endif
+#ifndef IMGSTORE_SEG_MAX_RECS
+#define IMGSTORE_SEG_MAX_RECS 4096                   // 每段最多图片数（id低16位）
+#endif
+#ifndef IMGSTORE_ALIGN
+#define IMGSTORE_ALIGN 512                           // 图片起始偏移按扇区对齐
+#endif
+
+// ===== 照片分目录与卡上目录文件（/DCIM/YYYYMMDD/HH/，catalog.bin 定长记录）=====
+#ifndef CATALOG_DIR
+#define CATALOG_DIR "/DCIM"
+#endif
+#ifndef CATALOG_PATH
+#define CATALOG_PATH CATALOG_DIR "/catalog.bin"
+#endif
+#ifndef CATALOG_TAIL
+#define CATALOG_TAIL 32                     // 常驻内存的最近记录数
+#endif
+#ifndef CATALOG_FIND_BLOCK
+#define CATALOG_FIND_BLOCK 16               // 按名字查找时每次从卡上读的记录数
+#endif
+
+// ===== 保留策略（剩余空间低于 SD_MIN_FREE_MB 时从旧到新删除，优先删已上传）=====
+#ifndef RETAIN_HYSTERESIS_MB
+#define RETAIN_HYSTERESIS_MB 64             // 清理到 SD_MIN_FREE_MB + 该值为止
+#endif
+#ifndef RETAIN_SCAN_WINDOW
+#define RETAIN_SCAN_WINDOW 256              // 每步顺序查看的目录记录数（找已上传的）
+#endif
+#ifndef RETAIN_REMEASURE_MS
+#define RETAIN_REMEASURE_MS (3600UL * 1000UL)   // 实测剩余空间的间隔（其余时间增量估算）
+#endif
+#ifndef SD_CHECK_INTERVAL_MS
+#define SD_CHECK_INTERVAL_MS 1000
+#endif
+
+// ===== 写后读缓存（最近保存的照片在PSRAM留副本，上传不等SD）=====
+#ifndef PHOTO_CACHE_ENABLE
+#define PHOTO_CACHE_ENABLE 1
+#endif
+#ifndef PHOTO_CACHE_SLOTS
+#define PHOTO_CACHE_SLOTS 4
+#endif
+#ifndef PHOTO_CACHE_BYTES
+#define PHOTO_CACHE_BYTES (512 * 1024)
+#endif
+
+// ===== 软RTC漂移补偿（误差上界超过容差才校时）=====
+#ifndef RTC_SYNC_TOLERANCE_MS
+#define RTC_SYNC_TOLERANCE_MS 1500          // 允许的时间误差上界
+#endif
+#ifndef RTC_SYNC_ERR_MS
+#define RTC_SYNC_ERR_MS 1000                // 单次校时误差（平台时间只到秒）
+#endif
+#ifndef RTC_SYNC_MAX_INTERVAL_MS
+#define RTC_SYNC_MAX_INTERVAL_MS 86400000UL // 最长校时间隔（1天）
+#endif
+#ifndef RTC_DRIFT_MAX_PPM
+#define RTC_DRIFT_MAX_PPM 100               // 晶振漂移的先验上限，超过的估计不采信
+#endif
+#ifndef RTC_DRIFT_FLOOR_PPM
+#define RTC_DRIFT_FLOOR_PPM 5               // 温漂等无法估计的残余漂移
+#endif
+#ifndef RTC_DRIFT_MIN_BASELINE_MS
+#define RTC_DRIFT_MIN_BASELINE_MS 3600000UL // 估计漂移所需的最短基线（1小时）
+#endif
+#ifndef RTC_OUTLIER_MARGIN_MS
+#define RTC_OUTLIER_MARGIN_MS 1000          // 离群判定：偏差超过误差上界+该值
+#endif
+#ifndef RTC_OUTLIER_ACCEPT_AFTER
+#define RTC_OUTLIER_ACCEPT_AFTER 3          // 连续离群次数达到后视为时间跳变而接受
+#endif
+
+// === 引脚 ===
+#define PWDN_GPIO 32
+#define RESET_GPIO -1
+#define XCLK_GPIO 0
+#define SIOD_GPIO 26
+#define SIOC_GPIO 27
+#define Y9_GPIO 35
+#define Y8_GPIO 34
+#define Y7_GPIO 39
+#define Y6_GPIO 36
+#define Y5_GPIO 21
+#define Y4_GPIO 19
+#define Y3_GPIO 18
+#define Y2_GPIO 5
+#define VSYNC_GPIO 25
+#define HREF_GPIO 23
+#define PCLK_GPIO 22
+
+// SD Pins
+#define SD_CS   13
+#define SD_SCK  14
+#define SD_MISO 2
+#define SD_MOSI 15
+
+// Flash
+#define FLASH_PIN 4
+#if FLASH_MODE
+  #define FLASH_FREQ_HZ      5000
+  #define FLASH_RES_BITS     8
+  #define FLASH_TIMER        LEDC_TIMER_1
+  #define FLASH_SPEED_MODE   LEDC_LOW_SPEED_MODE
+  #define FLASH_CHANNEL      LEDC_CHANNEL_4
+#endif
+
+// Button
+#define BUTTON_PIN 12
+#define TRIGGER_BUTTON 1
+#define TRIGGER_WATER_LEVEL 2
+#define TRIGGER_MOTION 3
+
+typedef struct {
+    bool saveEnabled;
+    bool sendEnabled;
+    bool asyncSDWrite;
+} RuntimeConfig;
+
+extern RuntimeConfig g_cfg;
+
+typedef struct {
+    uint32_t total_captures;
+    uint32_t last_frame_size;
+    uint32_t last_capture_ms;
+    uint32_t consecutive_capture_fail;
+    uint32_t consecutive_sd_fail;
+} RunStats;
+
+extern RunStats g_stats;
+
+// 拍照返回码
+#define CR_OK 0
+#define CR_CAMERA_NOT_READY 1
+#define CR_FRAME_GRAB_FAIL 2
+#define CR_SD_SAVE_FAIL 3
+
+// 升级相关占位
+typedef struct {
+    int state;
+} UpgradeState;
+#define UPG_DOWNLOADING 1
+#define UPG_FILE_INFO 2
+extern UpgradeState g_upg;
+extern bool g_debugMode;
+
+// 占位失败处理函数
+inline void handle_camera_failure() {}
+inline void handle_sd_failure() {}
@@ -1,13 +1,13 @@
-#include "crc16.h"
-
-uint16_t crc16_modbus(const uint8_t* data, size_t len) {
-  uint16_t crc = 0xFFFF;
-  for (size_t i = 0; i < len; ++i) {
-    crc ^= (uint16_t)data[i];
-    for (int j = 0; j < 8; ++j) {
-      if (crc & 0x0001) crc = (crc >> 1) ^ 0xA001;
-      else crc >>= 1;
-    }
-  }
-  return crc;
+#include "crc16.h"
+
+uint16_t crc16_modbus(const uint8_t* data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; ++i) {
+    crc ^= (uint16_t)data[i];
+    for (int j = 0; j < 8; ++j) {
+      if (crc & 0x0001) crc = (crc >> 1) ^ 0xA001;
+      else crc >>= 1;
+    }
+  }
+  return crc;
 }
\ No newline at end of file
@@ -1,6 +1,6 @@
-#pragma once
-
-#include <Arduino.h>
-
-// CRC-16/MODBUS (init 0xFFFF, poly 0xA001, LSB-first)
+#pragma once
+
+#include <Arduino.h>
+
+// CRC-16/MODBUS (init 0xFFFF, poly 0xA001, LSB-first)
 uint16_t crc16_modbus(const uint8_t* data, size_t len);
\ No newline at end of file
@@ -1,58 +1,231 @@
-#include "flash_module.h"
-#include "config.h"
-
-void flashInit(){
-#if FLASH_MODE
-  ledc_timer_config_t tcfg={
-    .speed_mode=LEDC_LOW_SPEED_MODE,
-    .duty_resolution=(ledc_timer_bit_t)8,
-    .timer_num=FLASH_TIMER,
-    .freq_hz=FLASH_FREQ_HZ,
-    .clk_cfg=LEDC_AUTO_CLK
-  };
-  ledc_timer_config(&tcfg);
-  ledc_channel_config_t ccfg={
-    .gpio_num=FLASH_PIN,
-    .speed_mode=LEDC_LOW_SPEED_MODE,
-    .channel=FLASH_CHANNEL,
-    .intr_type=LEDC_INTR_DISABLE,
-    .timer_sel=FLASH_TIMER,
-    .duty=0,
-    .hpoint=0
-#if ESP_IDF_VERSION_MAJOR>=5
-    , .flags={ .output_invert=0 }
-#endif
-  };
-  ledc_channel_config(&ccfg);
-#else
-  pinMode(FLASH_PIN, OUTPUT);
-  digitalWrite(FLASH_PIN, LOW);
-#endif
-}
-
-void flashSet(uint8_t d){
-#if FLASH_MODE
-  if(d>255)d=255;
-  if(d>0 && d<5)d=5;
-  ledc_set_duty(LEDC_LOW_SPEED_MODE, FLASH_CHANNEL, d);
-  ledc_update_duty(LEDC_LOW_SPEED_MODE, FLASH_CHANNEL);
-#else
-  (void)d;
-#endif
-}
-
-void flashOn(){
-#if FLASH_MODE
-  flashSet(DEFAULT_FLASH_DUTY);
-#else
-  digitalWrite(FLASH_PIN, HIGH);
-#endif
-}
-
-void flashOff(){
-#if FLASH_MODE
-  flashSet(0);
-#else
-  digitalWrite(FLASH_PIN, LOW);
-#endif
-}
\ No newline at end of file
+#include "flash_module.h"
+#include "config.h"
+#include "camera_module.h"
+#include "jpeg_tools.h"
+#include "sensor_roi.h"
+#include "motion_watch.h"
+#include "uart_utils.h"
+#include "esp_camera.h"
+#include <Preferences.h>
+
+// 标定结果：未标定时沿用默认占空比/预热时长
+static FlashCalInfo s_cal = { false, DEFAULT_FLASH_DUTY, FLASH_WARM_MS, 0, 0, 0, 0, 0 };
+static uint32_t s_last_attempt_ms = 0;
+
+static void cal_load(){
+  Preferences p;
+  if(!p.begin("flash", true)) return;
+  uint8_t d = p.getUChar("duty", 0);
+  uint16_t w = p.getUShort("warm", 0);
+  s_cal.ambient_luma = p.getUChar("amb", 0);
+  s_cal.lit_luma = p.getUChar("lit", 0);
+  p.end();
+  if(d == 0 || w == 0) return;
+  s_cal.valid = true;
+  s_cal.duty = d;
+  s_cal.warm_ms = w;
+}
+
+static void cal_save(){
+  Preferences p;
+  if(!p.begin("flash", false)) return;
+  p.putUChar("duty", s_cal.duty);
+  p.putUShort("warm", s_cal.warm_ms);
+  p.putUChar("amb", s_cal.ambient_luma);
+  p.putUChar("lit", s_cal.lit_luma);
+  p.end();
+}
+
+void flashInit(){
+#if FLASH_MODE
+  ledc_timer_config_t tcfg={
+    .speed_mode=LEDC_LOW_SPEED_MODE,
+    .duty_resolution=(ledc_timer_bit_t)8,
+    .timer_num=FLASH_TIMER,
+    .freq_hz=FLASH_FREQ_HZ,
+    .clk_cfg=LEDC_AUTO_CLK
+  };
+  ledc_timer_config(&tcfg);
+  ledc_channel_config_t ccfg={
+    .gpio_num=FLASH_PIN,
+    .speed_mode=LEDC_LOW_SPEED_MODE,
+    .channel=FLASH_CHANNEL,
+    .intr_type=LEDC_INTR_DISABLE,
+    .timer_sel=FLASH_TIMER,
+    .duty=0,
+    .hpoint=0
+#if ESP_IDF_VERSION_MAJOR>=5
+    , .flags={ .output_invert=0 }
+#endif
+  };
+  ledc_channel_config(&ccfg);
+#else
+  pinMode(FLASH_PIN, OUTPUT);
+  digitalWrite(FLASH_PIN, LOW);
+#endif
+#if FLASH_MODE && FLASH_CAL_ENABLE
+  cal_load();
+#endif
+}
+
+void flashSet(uint8_t d){
+#if FLASH_MODE
+  if(d>255)d=255;
+  if(d>0 && d<5)d=5;
+  ledc_set_duty(LEDC_LOW_SPEED_MODE, FLASH_CHANNEL, d);
+  ledc_update_duty(LEDC_LOW_SPEED_MODE, FLASH_CHANNEL);
+#else
+  (void)d;
+#endif
+}
+
+void flashOn(){
+#if FLASH_MODE
+  flashSet(s_cal.duty);
+#else
+  digitalWrite(FLASH_PIN, HIGH);
+#endif
+}
+
+void flashOff(){
+#if FLASH_MODE
+  flashSet(0);
+#else
+  digitalWrite(FLASH_PIN, LOW);
+#endif
+}
+
+uint16_t flash_warm_ms(){
+  return s_cal.warm_ms;
+}
+
+void flash_get_cal(FlashCalInfo& out){
+  out = s_cal;
+}
+
+void flash_note_dark_retake(){
+  s_cal.dark_retakes++;
+}
+
+#if FLASH_MODE && FLASH_CAL_ENABLE
+// 探测帧平均亮度：1/4缩放灰度解码；失败返回-1
+static int probe_luma(){
+  camera_fb_t* fb = camera_grab();
+  if(!fb) return -1;
+  JpegImage img;
+  bool ok = jpeg_decode_scaled(fb->buf, fb->len, JPG_SCALE_4X, true, &img);
+  esp_camera_fb_return(fb);
+  if(!ok) return -1;
+  uint32_t n = (uint32_t)img.w * img.h, sum = 0;
+  for(uint32_t i = 0; i < n; i++) sum += img.px[i];
+  jpeg_image_free(&img);
+  return n ? (int)(sum / n) : -1;
+}
+
+// 标定主体：传感器已切到探测分辨率并锁定曝光；成功时写入 s_cal（不落NVS）
+static bool run_calibration(){
+  flashOff();
+  discard_frames(2);
+  int amb = probe_luma();
+  if(amb < 0) return false;
+  if(amb > FLASH_CAL_MAX_AMBIENT){
+    log2Val("[FLASH] Cal skipped, ambient luma=", amb);
+    return false;
+  }
+
+  // 1) 逐级加占空比，找到达到目标亮度的最小值
+  int duty = 255, lit = -1;
+  for(int d = FLASH_CAL_DUTY_MIN; d <= 255; d += FLASH_CAL_DUTY_STEP){
+    flashSet((uint8_t)d);
+    discard_frames(1);          // 丢掉亮度切换过程中曝光的帧
+    int l = probe_luma();
+    if(l < 0) return false;
+    lit = l;
+    if(l >= FLASH_CAL_TARGET_LUMA){ duty = d; break; }
+  }
+  if(lit < 0) return false;
+  if(lit < FLASH_CAL_TARGET_LUMA){
+    flashSet(255);              // 满占空比也达不到目标：按满占空比继续测预热
+    discard_frames(1);
+    lit = probe_luma();
+    if(lit < 0) return false;
+  }
+
+  // 2) 从灭灯开灯，测亮度达到稳态 FLASH_CAL_SETTLE_PCT% 所需时间
+  flashOff();
+  discard_frames(2);
+  const int settle = amb + (lit - amb) * FLASH_CAL_SETTLE_PCT / 100;
+  uint32_t warm = FLASH_WARM_MS;
+  flashSet((uint8_t)duty);
+  uint32_t t0 = millis();
+  while(millis() - t0 < (uint32_t)FLASH_WARM_MS * 4){
+    int l = probe_luma();
+    if(l < 0) return false;
+    if(l >= settle){ warm = millis() - t0; break; }
+  }
+  flashOff();
+  if(warm < FLASH_CAL_WARM_MIN_MS) warm = FLASH_CAL_WARM_MIN_MS;
+  if(warm > FLASH_WARM_MS) warm = FLASH_WARM_MS;   // 不比默认值更长：剩余收敛交给每次拍照的丢帧
+
+  s_cal.valid = true;
+  s_cal.duty = (uint8_t)duty;
+  s_cal.warm_ms = (uint16_t)warm;
+  s_cal.ambient_luma = (uint8_t)amb;
+  s_cal.lit_luma = (uint8_t)(lit > 255 ? 255 : lit);
+  return true;
+}
+#endif
+
+bool flash_calibrate(){
+#if FLASH_MODE && FLASH_CAL_ENABLE
+  if(!camera_ok) return false;
+  s_last_attempt_ms = millis();
+  s_cal.attempts++;
+  motion_watch_release_sensor();
+  sensor_t* s = esp_camera_sensor_get();
+  if(!s) return false;
+
+  // 锁定曝光/增益，使亮度只随补光变化
+  framesize_t fs = (framesize_t)s->status.framesize;
+  if(s->set_framesize(s, FLASH_CAL_FRAME_SIZE) != 0) return false;
+  s->set_exposure_ctrl(s, 0);
+  s->set_aec_value(s, FLASH_CAL_AEC_VALUE);
+  s->set_gain_ctrl(s, 0);
+  s->set_agc_gain(s, FLASH_CAL_AGC_GAIN);
+
+  bool ok = run_calibration();
+
+  flashOff();
+  s->set_exposure_ctrl(s, 1);
+  s->set_gain_ctrl(s, 1);
+  s->set_framesize(s, fs);
+  roi_apply(s);
+  discard_frames(2);
+
+  if(ok){
+    s_cal.cal_ms = millis();
+    s_cal.dark_retakes = 0;
+    cal_save();
+#if ENABLE_LOG2
+    Serial2.printf("[FLASH] Cal duty=%u warm=%ums ambient=%u lit=%u\r\n",
+                   s_cal.duty, s_cal.warm_ms, s_cal.ambient_luma, s_cal.lit_luma);
+#endif
+  }
+  return ok;
+#else
+  return false;
+#endif
+}
+
+void flash_calibration_drive(){
+#if FLASH_MODE && FLASH_CAL_ENABLE
+  if(!camera_ok) return;
+  uint32_t now = millis();
+  // 失败或刚标定过：至少间隔 FLASH_CAL_RETRY_MS 再试
+  if(s_cal.attempts > 0 && now - s_last_attempt_ms < FLASH_CAL_RETRY_MS) return;
+  bool due = !s_cal.valid ||
+             (now - s_cal.cal_ms >= FLASH_CAL_INTERVAL_MS) ||
+             (s_cal.dark_retakes >= FLASH_CAL_DARK_RETAKES);
+  if(due) flash_calibrate();
+#endif
+}
@@ -1,7 +1,26 @@
-#pragma once
-#include <Arduino.h>
-
-void flashInit();
-void flashSet(uint8_t d);
-void flashOn();
-void flashOff();
\ No newline at end of file
+#pragma once
+#include <Arduino.h>
+
+void flashInit();
+void flashSet(uint8_t d);
+void flashOn();
+void flashOff();
+
+// 补光自动标定：锁定曝光后逐级提高占空比，用低分辨率探测帧测亮度，
+// 记录达到目标亮度的最小占空比与预热时长（存NVS）
+struct FlashCalInfo {
+  bool     valid;
+  uint8_t  duty;          // 标定占空比（未标定时为 DEFAULT_FLASH_DUTY）
+  uint16_t warm_ms;       // 标定预热时长（未标定时为 FLASH_WARM_MS）
+  uint8_t  ambient_luma;  // 标定时环境亮度（关灯）
+  uint8_t  lit_luma;      // 标定占空比下的亮度
+  uint32_t cal_ms;        // 上次标定时刻 millis()
+  uint32_t attempts;
+  uint32_t dark_retakes;  // 自上次标定以来的暗场重拍次数
+};
+
+bool flash_calibrate();              // 立即标定（环境过亮时放弃并返回false）
+void flash_calibration_drive();      // 主循环调用：到期或暗场重拍增多时重新标定
+void flash_note_dark_retake();       // 拍照流水线发生暗场回退时调用
+uint16_t flash_warm_ms();            // 当前应使用的预热时长
+void flash_get_cal(FlashCalInfo& out);
\ No newline at end of file
@@ -0,0 +1,206 @@
+#include "image_store.h"
+#include "sd_async.h"
+#include "crc16.h"
+#include "uart_utils.h"
+#include <SD.h>
+#include <FS.h>
+#include <Preferences.h>
+#include <esp_heap_caps.h>
+
+static bool     s_ready = false;
+static uint32_t s_seg = 0;        // 当前写入段号
+static uint32_t s_count = 0;      // 当前段已写记录数
+static uint32_t s_next_off = 0;   // 当前段下一张图片的写入偏移
+
+static inline uint32_t align_up(uint32_t v) {
+    return (v + IMGSTORE_ALIGN - 1) & ~(uint32_t)(IMGSTORE_ALIGN - 1);
+}
+
+static void seg_path(uint32_t seg, const char* ext, char* out, size_t outSize) {
+    snprintf(out, outSize, "%s/seg_%05lu.%s", IMGSTORE_DIR, (unsigned long)seg, ext);
+}
+
+static uint16_t rec_crc(const ImgStoreRec& r) {
+    return crc16_modbus((const uint8_t*)&r, offsetof(ImgStoreRec, crc));
+}
+
+static bool rec_valid(const ImgStoreRec& r, uint32_t seg, uint32_t idx) {
+    return r.crc == rec_crc(r) && r.id == ((seg << 16) | idx) && r.len > 0;
+}
+
+// 段文件预分配：在末尾写1字节，FAT 一次性分配整条簇链，后续写入不再扩展文件
+static void seg_prealloc(uint32_t seg) {
+    char bin[48];
+    seg_path(seg, "bin", bin, sizeof(bin));
+    if (SD.exists(bin)) return;
+    static const uint8_t zero = 0;
+    // 与 image_store_append 同一 .bin 路径，须同在事件环，否则跨环顺序无保证
+    SdAsyncAdmit adm;
+    adm.prio = SD_ASYNC_PRIO_EVENT;
+    adm.wait_ms = ASYNC_SD_SUBMIT_TIMEOUT_MS;
+    if (!sd_async_submit_ex(bin, IMGSTORE_SEG_SIZE - 1, &zero, 1, adm)) log2Str("[IMGSTORE] Prealloc submit failed: ", bin);
+}
+
+static void seg_roll() {
+    s_seg++;
+    s_count = 0;
+    s_next_off = 0;
+    Preferences p;
+    if (p.begin("imgstore", false)) {
+        p.putUInt("seg", s_seg);
+        p.end();
+    }
+    seg_prealloc(s_seg);
+    log2Val("[IMGSTORE] New segment ", (int)s_seg);
+}
+
+// 从当前段索引尾部恢复写入位置：只读最后一条有效记录，撕裂的尾部记录会被后续写覆盖
+static void seg_load_tail() {
+    s_count = 0;
+    s_next_off = 0;
+    char idx[48];
+    seg_path(s_seg, "idx", idx, sizeof(idx));
+    File f = SD.open(idx, FILE_READ);
+    if (!f) return;
+    uint32_t n = f.size() / sizeof(ImgStoreRec);
+    while (n > 0) {
+        ImgStoreRec r;
+        f.seek((n - 1) * sizeof(ImgStoreRec));
+        if (f.read((uint8_t*)&r, sizeof(r)) == sizeof(r) && rec_valid(r, s_seg, n - 1)) {
+            s_next_off = align_up(r.offset + r.len);
+            break;
+        }
+        n--;
+    }
+    f.close();
+    s_count = n;
+}
+
+bool image_store_init() {
+#if IMGSTORE_ENABLE
+    if (!SD.exists(IMGSTORE_DIR) && !SD.mkdir(IMGSTORE_DIR)) return false;
+    Preferences p;
+    if (p.begin("imgstore", true)) {
+        s_seg = p.getUInt("seg", 0);
+        p.end();
+    }
+    seg_load_tail();
+    if (s_count >= IMGSTORE_SEG_MAX_RECS || s_next_off >= IMGSTORE_SEG_SIZE) seg_roll();
+    else seg_prealloc(s_seg);
+    s_ready = true;
+#if ENABLE_LOG2
+    Serial2.printf("[IMGSTORE] seg=%lu count=%lu next=%lu\r\n",
+                   (unsigned long)s_seg, (unsigned long)s_count, (unsigned long)s_next_off);
+#endif
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool image_store_ready() { return s_ready; }
+
+bool image_store_current_segment(uint32_t* seg) {
+    if (!s_ready) return false;
+    if (seg) *seg = s_seg;
+    return true;
+}
+
+bool image_store_append(const uint8_t* jpg, size_t len, uint32_t epoch, uint16_t flags, uint32_t* outId) {
+    if (!s_ready || !jpg || len == 0 || len > IMGSTORE_SEG_SIZE) return false;
+    if (s_count >= IMGSTORE_SEG_MAX_RECS || s_next_off + len > IMGSTORE_SEG_SIZE) seg_roll();
+
+    ImgStoreRec r;
+    r.id = (s_seg << 16) | s_count;
+    r.epoch = epoch;
+    r.offset = s_next_off;
+    r.len = (uint32_t)len;
+    r.flags = flags;
+    r.crc = rec_crc(r);
+
+    // 先数据后索引：同在事件环，写任务按序执行，索引落盘时数据已在其之前写入
+    SdAsyncAdmit adm;
+    adm.prio = SD_ASYNC_PRIO_EVENT;
+    adm.wait_ms = ASYNC_SD_SUBMIT_TIMEOUT_MS;
+    char path[48];
+    seg_path(s_seg, "bin", path, sizeof(path));
+    if (!sd_async_submit_ex(path, r.offset, jpg, len, adm)) return false;
+    seg_path(s_seg, "idx", path, sizeof(path));
+    if (!sd_async_submit_ex(path, s_count * sizeof(ImgStoreRec), (const uint8_t*)&r, sizeof(r), adm)) return false;
+
+    s_next_off = align_up(r.offset + r.len);
+    s_count++;
+    if (outId) *outId = r.id;
+    return true;
+}
+
+bool image_store_get(uint32_t id, ImgStoreRec& rec) {
+    uint32_t seg = id >> 16, idx = id & 0xFFFF;
+    char path[48];
+    seg_path(seg, "idx", path, sizeof(path));
+    File f = SD.open(path, FILE_READ);
+    if (!f) return false;
+    bool ok = f.seek(idx * sizeof(ImgStoreRec)) &&
+              f.read((uint8_t*)&rec, sizeof(rec)) == sizeof(rec);
+    f.close();
+    return ok && rec_valid(rec, seg, idx);
+}
+
+uint8_t* image_store_read(uint32_t id, size_t maxLen, size_t& outLen) {
+    outLen = 0;
+    ImgStoreRec r;
+    if (!image_store_get(id, r) || r.len > maxLen) return nullptr;
+    char path[48];
+    seg_path(id >> 16, "bin", path, sizeof(path));
+    File f = SD.open(path, FILE_READ);
+    if (!f) return nullptr;
+    uint8_t* buf = (uint8_t*)heap_caps_malloc(r.len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!buf) buf = (uint8_t*)malloc(r.len);
+    bool ok = buf && f.seek(r.offset) && f.read(buf, r.len) == r.len;
+    f.close();
+    // 掉电撕裂的图片：SOI/EOI 不完整
+    if (ok) ok = r.len >= 4 && buf[0] == 0xFF && buf[1] == 0xD8 &&
+                 buf[r.len - 2] == 0xFF && buf[r.len - 1] == 0xD9;
+    if (!ok) { free(buf); return nullptr; }
+    outLen = r.len;
+    return buf;
+}
+
+uint32_t image_store_find_range(uint32_t t0, uint32_t t1, uint32_t* ids, uint32_t max) {
+    if (!s_ready || !ids || max == 0) return 0;
+    uint32_t found = 0;
+    ImgStoreRec buf[32];
+    for (int32_t seg = (int32_t)s_seg; seg >= 0 && found < max; seg--) {
+        char path[48];
+        seg_path((uint32_t)seg, "idx", path, sizeof(path));
+        File f = SD.open(path, FILE_READ);
+        if (!f) break;   // 更早的段已不存在
+        uint32_t minEpoch = UINT32_MAX, idx = 0;
+        size_t n;
+        while (found < max && (n = f.read((uint8_t*)buf, sizeof(buf)) / sizeof(ImgStoreRec)) > 0) {
+            for (size_t i = 0; i < n && found < max; i++, idx++) {
+                const ImgStoreRec& r = buf[i];
+                if (!rec_valid(r, (uint32_t)seg, idx) || r.epoch == 0) continue;
+                if (r.epoch < minEpoch) minEpoch = r.epoch;
+                if (r.epoch >= t0 && r.epoch <= t1) ids[found++] = r.id;
+            }
+        }
+        f.close();
+        if (minEpoch < t0) break;   // 段按时间先后写入，更早的段不会再命中
+    }
+    return found;
+}
+
+void image_store_make_name(uint32_t id, char* out, size_t outSize) {
+    snprintf(out, outSize, IMGSTORE_NAME_PREFIX "%lu", (unsigned long)id);
+}
+
+bool image_store_parse_name(const char* name, uint32_t* id) {
+    const size_t n = sizeof(IMGSTORE_NAME_PREFIX) - 1;
+    if (!name || strncmp(name, IMGSTORE_NAME_PREFIX, n) != 0) return false;
+    char* end = nullptr;
+    unsigned long v = strtoul(name + n, &end, 10);
+    if (end == name + n || *end) return false;
+    if (id) *id = (uint32_t)v;
+    return true;
+}
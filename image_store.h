@@ -0,0 +1,36 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// 追加式图片容器：JPEG 顺序写入预分配的大段文件，旁挂定长二进制索引。
+// 每段 IMGSTORE_DIR/seg_NNNNN.bin + seg_NNNNN.idx；图片id = 段号<<16 | 段内序号，
+// 按id定位只需一次索引读取，与已存图片数量无关
+struct ImgStoreRec {
+    uint32_t id;
+    uint32_t epoch;      // 拍摄时间（UTC秒，RTC未校时为0）
+    uint32_t offset;     // 段内偏移（IMGSTORE_ALIGN 对齐）
+    uint32_t len;
+    uint16_t flags;
+    uint16_t crc;        // 前面各字段的 CRC16
+} __attribute__((packed));
+
+// 容器内图片的逻辑名，供拍照/上传沿用“文件名”传递
+#define IMGSTORE_NAME_PREFIX "imgstore://"
+
+bool image_store_init();
+bool image_store_ready();
+bool image_store_current_segment(uint32_t* seg);   // 当前写入段（保留策略不得删除）
+
+// 追加一张图片（经 sd_async 定位写入，不阻塞）；成功返回id
+bool image_store_append(const uint8_t* jpg, size_t len, uint32_t epoch, uint16_t flags, uint32_t* outId);
+
+// 按id取索引记录 / 读取图片（PSRAM分配，调用方 free）
+bool image_store_get(uint32_t id, ImgStoreRec& rec);
+uint8_t* image_store_read(uint32_t id, size_t maxLen, size_t& outLen);
+
+// 时间范围查询 [t0, t1]：按段从新到旧，返回写入 ids 的个数（≤max）
+uint32_t image_store_find_range(uint32_t t0, uint32_t t1, uint32_t* ids, uint32_t max);
+
+// 逻辑名 <-> id
+void image_store_make_name(uint32_t id, char* out, size_t outSize);
+bool image_store_parse_name(const char* name, uint32_t* id);
@@ -0,0 +1,133 @@
+#include "jpeg_quality_ctl.h"
+#include "camera_module.h"
+#include "sd_async.h"
+#include "uart_utils.h"
+#include "esp_camera.h"
+
+// 模型：同一场景下 JPEG字节数 × quality ≈ 常数k（场景复杂度）。
+// 每帧用 len*q 更新 k 的滑动均值，下一帧取 q = k / 目标字节数。
+struct SceneState {
+    int      q;
+    uint32_t k;          // EWMA(len * q)
+    uint32_t ewma_len;   // EWMA(len)，仅用于统计
+    uint32_t samples;
+    int      applied;    // 本帧实际设置的画质（背压时比 q 大）
+};
+
+static SceneState s_scene[QCTL_SCENE_COUNT];
+static uint32_t s_over_cap = 0;
+static uint32_t s_over_cap_run = 0;   // 在最差画质下仍连续超限的帧数
+static uint32_t s_reinit_count = 0;
+static bool     s_reinit_done = false;
+static bool     s_reinit_pending = false;  // 兜底重初始化待执行（须在帧缓冲归还后）
+
+static inline int clamp_q(int q) {
+    if (q < QCTL_Q_MIN) return QCTL_Q_MIN;
+    if (q > QCTL_Q_MAX) return QCTL_Q_MAX;
+    return q;
+}
+
+void qctl_init(int start_quality) {
+    for (int i = 0; i < QCTL_SCENE_COUNT; i++) {
+        s_scene[i].q = clamp_q(start_quality);
+        s_scene[i].k = 0;
+        s_scene[i].ewma_len = 0;
+        s_scene[i].samples = 0;
+        s_scene[i].applied = s_scene[i].q;
+    }
+    s_over_cap_run = 0;
+}
+
+void qctl_before_capture(QctlScene scene) {
+#if QCTL_ENABLE
+    if (!camera_ok || scene >= QCTL_SCENE_COUNT) return;
+    sensor_t* s = esp_camera_sensor_get();
+    if (!s) return;
+    int q = s_scene[scene].q;
+    if (q <= 0) return;   // 尚未 qctl_init
+    // SD写队列吃紧：这一帧临时压小，不改模型的目标画质
+    if (sd_async_pressure(QCTL_TARGET_BYTES, SD_ASYNC_PRIO_EVENT) != SD_ASYNC_BP_OK) q = clamp_q(q + QCTL_BP_STEP);
+    s_scene[scene].applied = q;
+    if (s->status.quality != q) s->set_quality(s, q);
+#else
+    (void)scene;
+#endif
+}
+
+void qctl_after_capture(QctlScene scene, size_t jpeg_len) {
+    if (scene >= QCTL_SCENE_COUNT || jpeg_len == 0) return;
+    SceneState& st = s_scene[scene];
+
+    // 超限不再静默：计数并打日志
+    if (jpeg_len > QCTL_HARD_CAP_BYTES) {
+        s_over_cap++;
+        log2Val("[QCTL] Frame over cap, bytes=", (int)jpeg_len);
+    }
+
+#if QCTL_ENABLE
+    int used_q = st.applied > 0 ? st.applied : st.q;
+    uint32_t sample = (uint32_t)jpeg_len * (uint32_t)used_q;
+    if (st.samples == 0) {
+        st.k = sample;
+        st.ewma_len = jpeg_len;
+    } else {
+        st.k = st.k - (st.k >> QCTL_EWMA_SHIFT) + (sample >> QCTL_EWMA_SHIFT);
+        st.ewma_len = st.ewma_len - (st.ewma_len >> QCTL_EWMA_SHIFT) + ((uint32_t)jpeg_len >> QCTL_EWMA_SHIFT);
+    }
+    st.samples++;
+
+    // 预测当前画质下的大小，落在死区内不动，避免来回抖
+    uint32_t predicted = st.k / (uint32_t)st.q;
+    uint32_t band = QCTL_TARGET_BYTES / 10;
+    if (predicted + band < QCTL_TARGET_BYTES || predicted > QCTL_TARGET_BYTES + band) {
+        int want = (int)((st.k + QCTL_TARGET_BYTES - 1) / QCTL_TARGET_BYTES);
+        if (want > st.q + QCTL_MAX_STEP) want = st.q + QCTL_MAX_STEP;
+        if (want < st.q - QCTL_MAX_STEP) want = st.q - QCTL_MAX_STEP;
+        st.q = clamp_q(want);
+        if (scene == QCTL_SCENE_FLASH) camera_warm_note_quality(st.q);
+    }
+
+    // 兜底：画质已到最差仍连续超限，才降分辨率重初始化（每次上电最多一次）
+    if (jpeg_len > QCTL_HARD_CAP_BYTES && st.q >= QCTL_Q_MAX) {
+        if (++s_over_cap_run >= QCTL_REINIT_AFTER && !s_reinit_done) {
+            s_reinit_done = true;
+            s_reinit_count++;
+            s_reinit_pending = true;   // 调用方仍持有fb，这里只置标志
+            log2("[QCTL] Still over cap at worst quality, reinit with fallback frame size pending.");
+        }
+    } else {
+        s_over_cap_run = 0;
+    }
+#else
+    st.ewma_len = jpeg_len;
+    st.samples++;
+#endif
+}
+
+// 帧缓冲全部归还后由拍照流程收尾调用；重初始化经 on_camera_ready，画质模型随之重置
+void qctl_apply_pending_reinit() {
+    if (!s_reinit_pending) return;
+    if (!camera_lock(CAM_LOCK_WAIT_MS)) return;   // 拿不到锁下次再试
+    s_reinit_pending = false;
+    if (!reinit_camera_with_params(FRAME_SIZE_FALLBACK, JPEG_QUALITY_FALLBACK)) {
+        log2("[QCTL] Fallback reinit failed, supervisor will retry.");
+    }
+    camera_unlock();
+}
+
+// 暗场阈值按 JPEG_QUALITY_PREF 标定；画质调低后文件整体变小，阈值按同一模型等比缩放
+size_t qctl_dark_threshold() {
+    int q = s_scene[QCTL_SCENE_FLASH].q;
+    if (q <= 0) return JPEG_LEN_DARK_THRESH;
+    return (size_t)JPEG_LEN_DARK_THRESH * JPEG_QUALITY_PREF / (size_t)q;
+}
+
+void qctl_get_stats(QctlStats& out) {
+    for (int i = 0; i < QCTL_SCENE_COUNT; i++) {
+        out.quality[i] = (uint8_t)s_scene[i].q;
+        out.ewma_bytes[i] = s_scene[i].ewma_len;
+        out.samples[i] = s_scene[i].samples;
+    }
+    out.over_cap = s_over_cap;
+    out.reinit_count = s_reinit_count;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// 场景：不同光照路径下同画质的JPEG大小差异很大，分开跟踪
+enum QctlScene {
+    QCTL_SCENE_FLASH = 0,     // 补光常规路径（含连拍）
+    QCTL_SCENE_LOWLIGHT,      // 暗场回退路径（关灯+提升曝光）
+    QCTL_SCENE_COUNT
+};
+
+struct QctlStats {
+    uint8_t  quality[QCTL_SCENE_COUNT];     // 当前画质（esp32-camera: 越小越好）
+    uint32_t ewma_bytes[QCTL_SCENE_COUNT];  // 近期帧大小均值
+    uint32_t samples[QCTL_SCENE_COUNT];
+    uint32_t over_cap;                      // 超过 QCTL_HARD_CAP_BYTES 的帧数
+    uint32_t reinit_count;                  // 触发兜底重初始化次数
+};
+
+void qctl_init(int start_quality);            // 相机初始化成功后调用
+void qctl_before_capture(QctlScene scene);    // 抓帧前：按模型设置 set_quality
+void qctl_after_capture(QctlScene scene, size_t jpeg_len); // 抓帧后：更新模型（兜底重初始化只置待执行）
+void qctl_apply_pending_reinit();             // fb 归还后调用：执行待定的降分辨率重初始化
+size_t qctl_dark_threshold();                 // 按当前画质换算的暗场判定阈值
+void qctl_get_stats(QctlStats& out);
@@ -0,0 +1,122 @@
+#include "jpeg_tools.h"
+#include "config.h"
+#include "img_converters.h"
+#include <esp_heap_caps.h>
+#include <string.h>
+
+struct DecodeCtx {
+    const uint8_t* src;
+    JpegImage*     img;
+    bool           gray;
+};
+
+static size_t dec_read(void* arg, size_t index, uint8_t* buf, size_t len) {
+    DecodeCtx* c = (DecodeCtx*)arg;
+    if (buf) memcpy(buf, c->src + index, len);
+    return len;
+}
+
+// 解码器按MCU块回调，data 为 RGB888；首次回调(data==NULL, x=y=0)给出输出尺寸
+static bool dec_write(void* arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t* data) {
+    DecodeCtx* c = (DecodeCtx*)arg;
+    JpegImage* img = c->img;
+    if (!data) {
+        if (x == 0 && y == 0) {
+            img->w = w;
+            img->h = h;
+            img->bpp = c->gray ? 1 : 3;
+            size_t sz = (size_t)w * h * img->bpp;
+            img->px = (uint8_t*)heap_caps_malloc(sz, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+            if (!img->px) img->px = (uint8_t*)malloc(sz);
+            return img->px != nullptr;
+        }
+        return true;
+    }
+    if (!img->px) return false;
+
+    const size_t stride = (size_t)img->w * img->bpp;
+    for (uint16_t iy = 0; iy < h; iy++) {
+        uint8_t* o = img->px + (size_t)(y + iy) * stride + (size_t)x * img->bpp;
+        if (c->gray) {
+            // Y = (77R + 150G + 29B) >> 8，纯整数
+            for (uint16_t ix = 0; ix < w; ix++, data += 3) {
+                o[ix] = (uint8_t)((77 * data[0] + 150 * data[1] + 29 * data[2]) >> 8);
+            }
+        } else {
+            for (uint16_t ix = 0; ix < w; ix++, data += 3, o += 3) {
+                o[0] = data[2]; o[1] = data[1]; o[2] = data[0];
+            }
+        }
+    }
+    return true;
+}
+
+bool jpeg_decode_scaled(const uint8_t* jpg, size_t len, jpg_scale_t scale, bool gray, JpegImage* out) {
+    if (!jpg || len == 0 || !out) return false;
+    memset(out, 0, sizeof(*out));
+    DecodeCtx c = { jpg, out, gray };
+    if (esp_jpg_decode(len, scale, dec_read, dec_write, &c) != ESP_OK) {
+        jpeg_image_free(out);
+        return false;
+    }
+    return out->px != nullptr;
+}
+
+void jpeg_image_free(JpegImage* img) {
+    if (!img) return;
+    if (img->px) free(img->px);
+    img->px = nullptr;
+    img->w = img->h = 0;
+}
+
+bool jpeg_transcode_to_budget(const uint8_t* jpg, size_t len, size_t budget,
+                              jpg_scale_t min_scale, uint8_t** out, size_t* outLen) {
+    if (!out || !outLen) return false;
+    *out = nullptr;
+    *outLen = 0;
+
+    for (int sc = (int)min_scale; sc <= (int)JPG_SCALE_8X; sc++) {
+        JpegImage img;
+        if (!jpeg_decode_scaled(jpg, len, (jpg_scale_t)sc, false, &img)) return false;
+
+        // 同一尺度下逐级降画质；仍超预算再缩小一级
+        for (int q = THUMB_QUALITY_START; q >= THUMB_QUALITY_MIN; q -= THUMB_QUALITY_STEP) {
+            uint8_t* enc = nullptr;
+            size_t encLen = 0;
+            if (!fmt2jpg(img.px, (size_t)img.w * img.h * 3, img.w, img.h,
+                         PIXFORMAT_RGB888, (uint8_t)q, &enc, &encLen)) {
+                break;
+            }
+            if (encLen <= budget) {
+                jpeg_image_free(&img);
+                *out = enc;
+                *outLen = encLen;
+                return true;
+            }
+            free(enc);
+        }
+        jpeg_image_free(&img);
+    }
+    return false;
+}
+
+bool jpeg_insert_comment(const uint8_t* jpg, size_t len, const char* text,
+                         uint8_t** out, size_t* outLen) {
+    if (!jpg || len < 4 || !text || !out || !outLen) return false;
+    if (jpg[0] != 0xFF || jpg[1] != 0xD8) return false;   // 非SOI开头
+    size_t tlen = strlen(text);
+    if (tlen > 0xFFFF - 2) return false;
+
+    size_t total = len + 4 + tlen;
+    uint8_t* buf = (uint8_t*)malloc(total);
+    if (!buf) return false;
+    buf[0] = 0xFF; buf[1] = 0xD8;
+    buf[2] = 0xFF; buf[3] = 0xFE;                          // COM
+    buf[4] = (uint8_t)((tlen + 2) >> 8);
+    buf[5] = (uint8_t)((tlen + 2) & 0xFF);
+    memcpy(buf + 6, text, tlen);
+    memcpy(buf + 6 + tlen, jpg + 2, len - 2);
+    *out = buf;
+    *outLen = total;
+    return true;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <Arduino.h>
+#include "esp_jpg_decode.h"
+
+// 解码后的位图（PSRAM分配，用完调用 jpeg_image_free）
+struct JpegImage {
+    uint8_t* px;     // 灰度: 1字节/像素；彩色: BGR888，3字节/像素（与 fmt2jpg 输入一致）
+    uint16_t w;
+    uint16_t h;
+    uint8_t  bpp;    // 1 或 3
+};
+
+// 按 1/1、1/2、1/4、1/8 缩放解码；gray=true 时只输出亮度
+bool jpeg_decode_scaled(const uint8_t* jpg, size_t len, jpg_scale_t scale, bool gray, JpegImage* out);
+void jpeg_image_free(JpegImage* img);
+
+// 缩放+重编码到字节预算：从 min_scale 起逐级缩小、逐级降画质，直到结果 ≤ budget
+// 成功时 *out 为 malloc 分配（调用方 free）
+bool jpeg_transcode_to_budget(const uint8_t* jpg, size_t len, size_t budget,
+                              jpg_scale_t min_scale, uint8_t** out, size_t* outLen);
+
+// 在SOI之后插入COM段（携带元数据文本）；成功时 *out 为 malloc 分配（调用方 free）
+bool jpeg_insert_comment(const uint8_t* jpg, size_t len, const char* text,
+                         uint8_t** out, size_t* outLen);
@@ -1,157 +1,228 @@
-#include <Arduino.h>
-#include "config.h"
-#include "uart_utils.h"
-#include "state_machine.h"
-#include "platform_packet.h"
-#include "at_commands.h"
-#include "rtc_soft.h"
-#include "capture_trigger.h"
-#include "camera_module.h"
-#include "sdcard_module.h"
-#include "sd_async.h"            // 新增：异步SD队列处理
-#include "flash_module.h"        // 新增：补光灯初始化
-#include <Preferences.h>
-
-volatile int g_monitorEventUploadFlag = 0;
-unsigned long lastRtcPrint = 0;
-
-RuntimeConfig g_cfg = {true, true, true};
-RunStats g_stats = {0};
-UpgradeState g_upg = {0};
-bool g_debugMode = false;
-
-Preferences prefs;
-uint32_t photo_index = 1;
-uint8_t g_flashDuty = DEFAULT_FLASH_DUTY;
-uint32_t last_params_saved_ms = 0;
-
-// 按钮消抖及 busy 标志
-int lastButtonState = HIGH;
-unsigned long lastDebounceTime = 0;
-const unsigned long debounceDelay = 50; // ms
-bool captureBusy = false;
-
-// 新增：长按判定变量
-static bool waitingForLongPress = false;
-static unsigned long buttonPressStartMs = 0;
-
-void setup() {
-  Serial.begin(DTU_BAUD);
-#if ENABLE_LOG2
-  Serial2.begin(LOG_BAUD, SERIAL_8N1, RX2, TX2);
-#endif
-
-  Serial.println("==== System Boot ====");
-  Serial.println("1. Initializing Camera...");
-  bool camera_ok_local = init_camera_multi();
-  camera_ok = camera_ok_local; // 关键修复：同步全局状态，避免二次初始化
-  if (camera_ok_local) {
-    Serial.println("Camera OK");
-  } else {
-    Serial.println("[ERR] Camera init failed!");
-    while(1) delay(1000);
-  }
-
-  Serial.println("2. Initializing SD Card...");
-  init_sd();
-  if (SD.cardType() == CARD_NONE) {
-    Serial.println("[ERR] SD card init failed!");
-    while(1) delay(1000);
-  } else {
-    Serial.println("SD card OK");
-  }
-
-  // 初始化异步SD队列
-  sd_async_init();
-  sd_async_start();
-  sd_async_on_sd_ready();
-
-  // 初始化补光灯PWM，确保首次拍照可控
-  flashInit();
-
-  Serial.println("3. Loading config from NVS...");
-  if (!prefs.begin("cfg", false)) {
-    Serial.println("[ERR] NVS init failed!");
-    while(1) delay(1000);
-  }
-  load_params_from_nvs();
-  Serial.println("NVS OK");
-
-  Serial.println("4. Initializing RTC (soft)...");
-  rtc_init();
-  Serial.println("RTC init finish (valid after time sync)");
-
-  // 自检完成后先拍一张测试照（仅保存，不上传）
-  Serial.println("5. Taking initial test photo (save only)...");
-  bool prevSend = g_cfg.sendEnabled;
-  bool prevAsync = g_cfg.asyncSDWrite;
-  g_cfg.sendEnabled = false;       // 只保存不上传
-  // 异步写保持开启，避免阻塞
-  bool ok = capture_and_process(TRIGGER_BUTTON, false);
-  g_cfg.sendEnabled = prevSend;
-  g_cfg.asyncSDWrite = prevAsync;
-  if (ok) {
-    Serial.println("Initial photo captured and saved to SD.");
-  } else {
-    Serial.println("[ERR] Initial photo capture or save failed!");
-  }
-
-  Serial.println("All hardware OK, ready to start platform connection...");
-
-  resetBackoff();
-  gotoStep(STEP_IDLE);
-
-  pinMode(BUTTON_PIN, INPUT_PULLUP);
-}
-
-void loop()
-{
-  readDTU();
-  driveStateMachine();
-
-  // 按钮检测与消抖
-  int reading = digitalRead(BUTTON_PIN);
-  if (reading != lastButtonState) {
-    lastDebounceTime = millis();
-  }
-  if ((millis() - lastDebounceTime) > debounceDelay) {
-    static int lastStableState = HIGH;
-
-    // --------- 长按10秒拍照逻辑 ---------
-    if (reading == LOW) { // 按钮按下
-      if (!waitingForLongPress) {
-        // 第一次检测到按下，记录时间
-        buttonPressStartMs = millis();
-        waitingForLongPress = true;
-      } else if (!captureBusy && (millis() - buttonPressStartMs > 10000)) {
-        // 持续按下超过10秒，执行拍照
-        captureBusy = true;
-#if ENABLE_LOG2
-        Serial2.println("[BTN] Button long pressed (>10s), start capture!");
-#endif
-        bool ok = capture_and_process(TRIGGER_BUTTON, true);
-#if ENABLE_LOG2
-        if (ok) Serial2.println("[BTN] Capture saved; event flagged for upload.");
-        else Serial2.println("[BTN] Capture failed!");
-#endif
-        captureBusy = false;
-        waitingForLongPress = false; // 防止重复触发
-      }
-    } else { // 按钮松开
-      waitingForLongPress = false;
-      buttonPressStartMs = 0;
-    }
-    // --------- END 长按10秒拍照逻辑 ---------
-
-    lastStableState = reading;
-  }
-  lastButtonState = reading;
-
-  // 只在未校时时每10秒提示一次
-  if (!rtc_is_valid() && millis() - lastRtcPrint > 10000) {
-    lastRtcPrint = millis();
-#if ENABLE_LOG2
-    Serial2.println("[RTC] Not valid yet.");
-#endif
-  }
+#include <Arduino.h>
+#include "config.h"
+#include "uart_utils.h"
+#include "state_machine.h"
+#include "platform_packet.h"
+#include "at_commands.h"
+#include "rtc_soft.h"
+#include "capture_trigger.h"
+#include "camera_module.h"
+#include "sdcard_module.h"
+#include "sd_async.h"            // 新增：异步SD队列处理
+#include "flash_module.h"        // 新增：补光灯初始化
+#include "camera_supervisor.h"    // 相机健康监督任务
+#include "image_store.h"          // 图片容器存储
+#include "photo_catalog.h"        // 照片目录（分目录+卡上索引）
+#include "sd_retention.h"         // SD剩余空间保留策略
+#include "burst_ring.h"          // 连拍PSRAM环形槽
+#include "water_level.h"         // 水位识别
+#include "motion_watch.h"        // 运动监视触发
+#include <Preferences.h>
+
+volatile int g_monitorEventUploadFlag = 0;
+unsigned long lastRtcPrint = 0;
+
+RuntimeConfig g_cfg = {true, true, true};
+RunStats g_stats = {0};
+UpgradeState g_upg = {0};
+bool g_debugMode = false;
+
+Preferences prefs;
+uint32_t photo_index = 1;
+uint8_t g_flashDuty = DEFAULT_FLASH_DUTY;
+uint32_t last_params_saved_ms = 0;
+
+// 按钮消抖及 busy 标志
+int lastButtonState = HIGH;
+unsigned long lastDebounceTime = 0;
+const unsigned long debounceDelay = 50; // ms
+bool captureBusy = false;
+
+// 新增：长按判定变量
+static bool waitingForLongPress = false;
+static unsigned long buttonPressStartMs = 0;
+
+// 掉电留下的半截照片：目录中标记删除，补传不再选它
+static void on_partial_photo(const char* path) {
+  catalog_mark_deleted(path);
+  log2Str("[SD] Quarantined partial file: ", path);
+}
+
+void setup() {
+  Serial.begin(DTU_BAUD);
+#if ENABLE_LOG2
+  Serial2.begin(LOG_BAUD, SERIAL_8N1, RX2, TX2);
+#endif
+
+  Serial.println("==== System Boot ====");
+  Serial.println("1. Initializing Camera...");
+  if (!camera_lock_init()) {
+    Serial.println("[ERR] Camera mutex alloc failed!");
+    while(1) delay(1000);
+  }
+  bool camera_ok_local = init_camera_multi();
+  camera_ok = camera_ok_local; // 关键修复：同步全局状态，避免二次初始化
+  if (camera_ok_local) {
+    Serial.println("Camera OK");
+    Serial.printf("Camera ready at %lu ms after boot (init %lu ms, %s)\n",
+                  (unsigned long)camera_ready_ms(), (unsigned long)camera_last_init_cost_ms(),
+                  camera_last_init_was_warm() ? "warm cache" : "cold");
+  } else {
+    // 不再死等：监督任务会按退避重试初始化，持续失败则重启
+    Serial.println("[ERR] Camera init failed! Supervisor will retry in background.");
+  }
+
+  Serial.println("2. Initializing SD Card...");
+  init_sd();
+  if (SD.cardType() == CARD_NONE) {
+    Serial.println("[ERR] SD card init failed!");
+    while(1) delay(1000);
+  } else {
+    Serial.println("SD card OK");
+  }
+
+  // 初始化异步SD队列
+  sd_async_init();
+  sd_async_on_sd_ready();
+  if (image_store_init()) {
+    Serial.println("Image store ready");
+  }
+  if (!catalog_init()) {
+    Serial.println("[WARN] Photo catalog init failed.");
+  }
+  // 写任务启动前按写日志检查上次掉电时未写完的文件
+  uint32_t partial = sd_async_recover(on_partial_photo);
+  if (partial) Serial.printf("[WARN] %lu partial file(s) quarantined\n", (unsigned long)partial);
+  sd_async_start();
+  retention_init();
+#if ASYNC_SD_BENCH_BYTES > 0
+  Serial.printf("SD async write bench: %lu KB/s\n", (unsigned long)sd_async_benchmark(ASYNC_SD_BENCH_BYTES));
+#endif
+
+  // 初始化补光灯PWM，确保首次拍照可控
+  flashInit();
+
+  // 连拍槽位开机即预分配，避免触发时再申请PSRAM（仅在启用了连拍触发时；否则 capture_burst 首次调用再分配）
+#if BURST_ON_BUTTON || WL_ENABLE
+  if (!burst_ring_init()) {
+    Serial.println("[WARN] Burst ring alloc failed, burst falls back to single shot.");
+  }
+#endif
+
+  Serial.println("3. Loading config from NVS...");
+  if (!prefs.begin("cfg", false)) {
+    Serial.println("[ERR] NVS init failed!");
+    while(1) delay(1000);
+  }
+  load_params_from_nvs();
+  Serial.println("NVS OK");
+
+  Serial.println("4. Initializing RTC (soft)...");
+  rtc_init();
+  Serial.println("RTC init finish (valid after time sync)");
+
+  // 自检完成后先拍一张测试照（仅保存，不上传）
+  Serial.println("5. Taking initial test photo (save only)...");
+  bool prevSend = g_cfg.sendEnabled;
+  bool prevAsync = g_cfg.asyncSDWrite;
+  g_cfg.sendEnabled = false;       // 只保存不上传
+  // 异步写保持开启，避免阻塞
+  bool ok = capture_and_process(TRIGGER_BUTTON, false);
+  g_cfg.sendEnabled = prevSend;
+  g_cfg.asyncSDWrite = prevAsync;
+  if (ok) {
+    Serial.println("Initial photo captured and saved to SD.");
+  } else {
+    Serial.println("[ERR] Initial photo capture or save failed!");
+  }
+
+  Serial.println("All hardware OK, ready to start platform connection...");
+
+  // 相机健康监督：取帧失败/卡死时后台重初始化，超限重启
+  if (!camera_supervisor_start()) {
+    Serial.println("[WARN] Camera supervisor not started.");
+  }
+
+  resetBackoff();
+  gotoStep(STEP_IDLE);
+
+  pinMode(BUTTON_PIN, INPUT_PULLUP);
+}
+
+void loop()
+{
+  readDTU();
+  driveStateMachine();
+
+  // 按钮检测与消抖
+  int reading = digitalRead(BUTTON_PIN);
+  if (reading != lastButtonState) {
+    lastDebounceTime = millis();
+  }
+  if ((millis() - lastDebounceTime) > debounceDelay) {
+    static int lastStableState = HIGH;
+
+    // --------- 长按10秒拍照逻辑 ---------
+    if (reading == LOW) { // 按钮按下
+      if (!waitingForLongPress) {
+        // 第一次检测到按下，记录时间
+        buttonPressStartMs = millis();
+        waitingForLongPress = true;
+      } else if (!captureBusy && (millis() - buttonPressStartMs > 10000) && camera_lock(CAM_LOCK_WAIT_MS)) {
+        // 持续按下超过10秒，执行拍照（监督任务重初始化期间等待其释放相机）
+        captureBusy = true;
+#if ENABLE_LOG2
+        Serial2.println("[BTN] Button long pressed (>10s), start capture!");
+#endif
+#if BURST_ON_BUTTON
+        bool ok = capture_burst(TRIGGER_BUTTON, BURST_FRAMES, BURST_INTERVAL_MS, true);
+#else
+        bool ok = capture_and_process(TRIGGER_BUTTON, true);
+#endif
+#if ENABLE_LOG2
+        if (ok) Serial2.println("[BTN] Capture saved; event flagged for upload.");
+        else Serial2.println("[BTN] Capture failed!");
+#endif
+        captureBusy = false;
+        camera_unlock();
+        waitingForLongPress = false; // 防止重复触发
+      }
+    } else { // 按钮松开
+      waitingForLongPress = false;
+      buttonPressStartMs = 0;
+    }
+    // --------- END 长按10秒拍照逻辑 ---------
+
+    lastStableState = reading;
+  }
+  lastButtonState = reading;
+
+  // 定时水位测量；上穿阈值时自动连拍并上传
+  // 运动监视：低分辨率灰度帧块差分，发现运动自动拍照上传
+  // 补光标定：首次/每天/暗场重拍增多时锁曝光测亮度，更新占空比与预热时长
+  if (!captureBusy && camera_lock(0)) {
+    captureBusy = true;
+    flash_calibration_drive();
+    water_level_drive();
+    motion_watch_drive();
+    captureBusy = false;
+    camera_unlock();
+  }
+
+  // 异步读完成回调（在主循环上下文执行）
+  sd_async_poll();
+
+  // SD健康检查与保留策略（写任务空闲时每次最多删一张）
+  periodic_sd_check();
+
+  // 监督任务请求的重启在主循环执行
+  camera_supervisor_poll();
+
+  // 只在未校时时每10秒提示一次
+  if (!rtc_is_valid() && millis() - lastRtcPrint > 10000) {
+    lastRtcPrint = millis();
+#if ENABLE_LOG2
+    Serial2.println("[RTC] Not valid yet.");
+#endif
+  }
 }
\ No newline at end of file
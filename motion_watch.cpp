@@ -0,0 +1,130 @@
+#include "motion_watch.h"
+#include "camera_module.h"
+#include "capture_trigger.h"
+#include "jpeg_tools.h"
+#include "sensor_roi.h"
+#include "uart_utils.h"
+#include "esp_camera.h"
+#include <string.h>
+
+// 监视帧上限：QQVGA 按 1/2 解码为 80x60
+#define MW_MAX_W 160
+#define MW_MAX_PIXELS (MW_MAX_W * 120)
+#define MW_BLOCK 8
+
+static uint8_t  s_prev[MW_MAX_PIXELS];
+static uint16_t s_prev_w = 0, s_prev_h = 0;
+static bool     s_lowres = false;
+static framesize_t s_saved_fs = FRAME_SIZE_PREF;
+static uint32_t s_last_tick_ms = 0;
+static uint32_t s_cooldown_until = 0;
+static uint8_t  s_hits = 0;
+static uint32_t s_cam_gen = 0;
+static MotionWatchStats s_stats = {0, 0, 0, 0, 0, false};
+
+uint32_t motion_block_diff(const uint8_t* cur, const uint8_t* prev, uint16_t w, uint16_t h) {
+    const uint16_t bw = w / MW_BLOCK, bh = h / MW_BLOCK;
+    if (!bw || !bh || bw > MW_MAX_W / MW_BLOCK) return 0;
+
+    // 整体亮度偏移（自动曝光缓慢变化时不应触发）
+    int32_t bias = 0;
+    const uint32_t n = (uint32_t)w * h;
+    for (uint32_t i = 0; i < n; i++) bias += (int32_t)cur[i] - (int32_t)prev[i];
+    bias /= (int32_t)n;
+
+    // 逐块 SAD：块行内按行顺序访存，每块累加到行缓冲
+    uint32_t sad[MW_MAX_W / MW_BLOCK];
+    uint32_t blocks = 0;
+    for (uint16_t by = 0; by < bh; by++) {
+        memset(sad, 0, sizeof(uint32_t) * bw);
+        for (uint16_t y = by * MW_BLOCK; y < (by + 1) * MW_BLOCK; y++) {
+            const uint8_t* c = cur + (size_t)y * w;
+            const uint8_t* p = prev + (size_t)y * w;
+            for (uint16_t x = 0; x < bw * MW_BLOCK; x++) {
+                int32_t d = (int32_t)c[x] - (int32_t)p[x] - bias;
+                sad[x / MW_BLOCK] += (uint32_t)(d < 0 ? -d : d);
+            }
+        }
+        for (uint16_t bx = 0; bx < bw; bx++) {
+            if (sad[bx] > (uint32_t)MW_BLOCK_THRESH * MW_BLOCK * MW_BLOCK) blocks++;
+        }
+    }
+    return blocks;
+}
+
+static bool enter_lowres() {
+    if (s_lowres) return true;
+    sensor_t* s = esp_camera_sensor_get();
+    if (!s) return false;
+    s_saved_fs = (framesize_t)s->status.framesize;
+    if (s->set_framesize(s, MW_FRAME_SIZE) != 0) return false;
+    s_lowres = true;
+    s_prev_w = s_prev_h = 0;   // 切换后丢弃旧参考
+    discard_frames(1);
+    return true;
+}
+
+void motion_watch_release_sensor() {
+    if (!s_lowres) return;
+    sensor_t* s = esp_camera_sensor_get();
+    if (s) {
+        s->set_framesize(s, s_saved_fs);
+        roi_apply(s);   // set_framesize 会覆盖开窗，需重新下发
+    }
+    s_lowres = false;
+    s_prev_w = s_prev_h = 0;
+}
+
+void motion_watch_drive() {
+#if MW_ENABLE
+    uint32_t now = millis();
+    if (!camera_ok) return;
+    if (now - s_last_tick_ms < MW_INTERVAL_MS) return;
+    s_last_tick_ms = now;
+    if ((int32_t)(now - s_cooldown_until) < 0) return;
+    if (s_cam_gen != camera_init_generation()) {
+        // 相机被重初始化：传感器已回到配置分辨率，监视状态作废
+        s_cam_gen = camera_init_generation();
+        s_lowres = false;
+        s_prev_w = s_prev_h = 0;
+    }
+    if (!enter_lowres()) return;
+
+    camera_fb_t* fb = camera_grab();
+    if (!fb) return;
+    uint32_t t0 = micros();
+    JpegImage img;
+    bool ok = jpeg_decode_scaled(fb->buf, fb->len, MW_DECODE_SCALE, true, &img);
+    esp_camera_fb_return(fb);
+    if (!ok) return;
+    if ((uint32_t)img.w * img.h > MW_MAX_PIXELS) { jpeg_image_free(&img); return; }
+
+    uint32_t blocks = 0;
+    bool haveRef = (s_prev_w == img.w && s_prev_h == img.h);
+    if (haveRef) blocks = motion_block_diff(img.px, s_prev, img.w, img.h);
+    memcpy(s_prev, img.px, (size_t)img.w * img.h);
+    s_prev_w = img.w; s_prev_h = img.h;
+    jpeg_image_free(&img);
+
+    s_stats.frames++;
+    s_stats.last_blocks = blocks;
+    s_stats.last_cost_us = micros() - t0;
+    if (s_stats.last_cost_us > s_stats.max_cost_us) s_stats.max_cost_us = s_stats.last_cost_us;
+
+    // 连续 MW_CONFIRM_FRAMES 帧超过块数阈值才确认，抑制单帧噪声
+    s_hits = (haveRef && blocks >= MW_MIN_BLOCKS) ? s_hits + 1 : 0;
+    if (s_hits < MW_CONFIRM_FRAMES) return;
+    s_hits = 0;
+    s_stats.triggers++;
+    s_cooldown_until = now + MW_COOLDOWN_MS;
+    log2Val("[MW] Motion detected, blocks=", (int)blocks);
+
+    // 拍照流程内部会先恢复全分辨率
+    capture_and_process(TRIGGER_MOTION, true);
+#endif
+}
+
+void motion_watch_get_stats(MotionWatchStats& out) {
+    out = s_stats;
+    out.lowres = s_lowres;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+struct MotionWatchStats {
+    uint32_t frames;          // 已处理的监视帧
+    uint32_t triggers;        // 触发拍照次数
+    uint32_t last_blocks;     // 最近一帧变化块数
+    uint32_t last_cost_us;    // 最近一帧 取帧后的解码+核函数耗时
+    uint32_t max_cost_us;
+    bool     lowres;          // 传感器当前是否处于监视低分辨率
+};
+
+// 主循环调用：按 MW_INTERVAL_MS 取一帧低分辨率灰度图做块差分，发现运动则拍照上传
+void motion_watch_drive();
+
+// 拍照前调用：若传感器处于监视低分辨率，恢复原分辨率（及ROI开窗）
+void motion_watch_release_sensor();
+
+// 块差分核：两帧同尺寸灰度图，统计 8x8 块平均绝对差超过阈值的块数（已扣除整体亮度偏移）
+uint32_t motion_block_diff(const uint8_t* cur, const uint8_t* prev, uint16_t w, uint16_t h);
+
+void motion_watch_get_stats(MotionWatchStats& out);
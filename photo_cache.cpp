@@ -0,0 +1,118 @@
+#include "photo_cache.h"
+#include <esp_heap_caps.h>
+#include <string.h>
+
+struct CacheEntry {
+    char     name[64];
+    uint8_t* buf;        // nullptr 表示空槽
+    size_t   len;
+    uint8_t  pinned;     // PHOTO_PIN_* 按位，非0不淘汰
+    uint32_t stamp;      // 最近使用序号（LRU）
+};
+
+static CacheEntry s_ent[PHOTO_CACHE_SLOTS];
+static size_t   s_bytes = 0;
+static uint32_t s_clock = 0;
+static PhotoCacheStats s_stats = {0, 0, 0, 0, 0, 0};
+
+static CacheEntry* find(const char* name) {
+    if (!name || !name[0]) return nullptr;
+    for (int i = 0; i < PHOTO_CACHE_SLOTS; i++) {
+        if (s_ent[i].buf && strncmp(s_ent[i].name, name, sizeof(s_ent[i].name)) == 0) return &s_ent[i];
+    }
+    return nullptr;
+}
+
+static void drop(CacheEntry& e) {
+    if (!e.buf) return;
+    free(e.buf);
+    s_bytes -= e.len;
+    e.buf = nullptr;
+    e.len = 0;
+    e.pinned = 0;
+    e.name[0] = '\0';
+}
+
+// 淘汰最久未用且未钉住的一项；没有可淘汰项返回 false
+static bool evict_lru() {
+    CacheEntry* victim = nullptr;
+    for (int i = 0; i < PHOTO_CACHE_SLOTS; i++) {
+        CacheEntry& e = s_ent[i];
+        if (!e.buf || e.pinned) continue;
+        if (!victim || (int32_t)(e.stamp - victim->stamp) < 0) victim = &e;
+    }
+    if (!victim) return false;
+    drop(*victim);
+    return true;
+}
+
+bool photo_cache_put(const char* name, const uint8_t* data, size_t len) {
+#if PHOTO_CACHE_ENABLE
+    if (!name || !name[0] || !data || len == 0 || len > PHOTO_CACHE_BYTES) return false;
+    CacheEntry* old = find(name);
+    if (old && old->len == len && memcmp(old->buf, data, len) == 0) {
+        old->stamp = ++s_clock;
+        return true;
+    }
+    uint8_t pins = old ? old->pinned : 0;
+    if (old) drop(*old);
+
+    CacheEntry* slot = nullptr;
+    for (;;) {
+        slot = nullptr;
+        for (int i = 0; i < PHOTO_CACHE_SLOTS && !slot; i++) if (!s_ent[i].buf) slot = &s_ent[i];
+        if (slot && s_bytes + len <= PHOTO_CACHE_BYTES) break;
+        if (!evict_lru()) { s_stats.rejects++; return false; }
+    }
+    uint8_t* buf = (uint8_t*)heap_caps_malloc(len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!buf) { s_stats.rejects++; return false; }
+    memcpy(buf, data, len);
+    strncpy(slot->name, name, sizeof(slot->name) - 1);
+    slot->name[sizeof(slot->name) - 1] = '\0';
+    slot->buf = buf;
+    slot->len = len;
+    slot->pinned = pins;
+    slot->stamp = ++s_clock;
+    s_bytes += len;
+    return true;
+#else
+    (void)name; (void)data; (void)len;
+    return false;
+#endif
+}
+
+void photo_cache_pin(const char* name, uint8_t why) {
+    CacheEntry* e = find(name);
+    if (e) e->pinned |= why;
+}
+
+void photo_cache_unpin(const char* name, uint8_t why) {
+    CacheEntry* e = find(name);
+    if (e) e->pinned &= (uint8_t)~why;
+}
+
+bool photo_cache_get(const char* name, const uint8_t** data, size_t* len) {
+    CacheEntry* e = find(name);
+    if (!e) { s_stats.misses++; return false; }
+    s_stats.hits++;
+    e->stamp = ++s_clock;
+    if (data) *data = e->buf;
+    if (len) *len = e->len;
+    return true;
+}
+
+bool photo_cache_has(const char* name) {
+    return find(name) != nullptr;
+}
+
+void photo_cache_get_stats(PhotoCacheStats& out) {
+    out = s_stats;
+    out.entries = 0;
+    out.pinned = 0;
+    for (int i = 0; i < PHOTO_CACHE_SLOTS; i++) {
+        if (!s_ent[i].buf) continue;
+        out.entries++;
+        if (s_ent[i].pinned) out.pinned++;
+    }
+    out.bytes = (uint32_t)s_bytes;
+}
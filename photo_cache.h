@@ -0,0 +1,28 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// 写后读缓存：最近保存的照片在PSRAM留一份副本（按文件名索引），上传直接从内存取，
+// 不必等 sd_async 写完再从SD读回。待上传/待补写的照片钉住（pin），用完解钉，其余按LRU淘汰
+#define PHOTO_PIN_UPLOAD 0x01   // 等待事件上传
+#define PHOTO_PIN_DEFER  0x02   // 写队列满暂缓入队，SD上还没有
+struct PhotoCacheStats {
+    uint32_t entries;
+    uint32_t bytes;
+    uint32_t pinned;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t rejects;    // 空间被钉住的照片占满，未能缓存
+};
+
+// 保存时调用：复制一份（超出 PHOTO_CACHE_BYTES 时淘汰未钉住的最旧项）。同名重放保留已有的钉住标志
+bool photo_cache_put(const char* name, const uint8_t* data, size_t len);
+void photo_cache_pin(const char* name, uint8_t why = PHOTO_PIN_UPLOAD);
+void photo_cache_unpin(const char* name, uint8_t why = PHOTO_PIN_UPLOAD);
+
+// 命中返回 true；*data 在下一次 put 之前有效
+bool photo_cache_get(const char* name, const uint8_t** data, size_t* len);
+// 只查是否在缓存中：不计命中/未命中，不刷新LRU
+bool photo_cache_has(const char* name);
+
+void photo_cache_get_stats(PhotoCacheStats& out);
@@ -0,0 +1,247 @@
+#include "photo_catalog.h"
+#include "sd_async.h"
+#include "crc16.h"
+#include "uart_utils.h"
+#include <SD.h>
+#include <FS.h>
+#include <Preferences.h>
+
+static bool     s_ready = false;
+static uint32_t s_count = 0;
+
+// 最近 CATALOG_TAIL 条记录常驻内存：新写入的记录可能还在写队列中，查询和回写标志不必等SD
+static CatalogRec s_tail[CATALOG_TAIL];
+
+// 上传游标：其之前的记录都已上传或已删除（NVS保存，节流写）
+static uint32_t s_upl_cursor = 0;
+static uint32_t s_upl_saved = 0;
+static uint32_t s_upl_save_ms = 0;
+
+static uint16_t rec_crc(const CatalogRec& r) {
+    CatalogRec t = r;
+    t.crc = 0;
+    return crc16_modbus((const uint8_t*)&t, sizeof(t));
+}
+
+static inline bool in_tail(uint32_t idx) {
+    return idx < s_count && s_count - idx <= CATALOG_TAIL;
+}
+
+static bool read_rec_sd(File& f, uint32_t idx, CatalogRec& out) {
+    return f.seek(idx * sizeof(CatalogRec)) &&
+           f.read((uint8_t*)&out, sizeof(out)) == sizeof(out) &&
+           out.crc == rec_crc(out);
+}
+
+static bool write_rec(uint32_t idx, const CatalogRec& r) {
+    return sd_async_submit_at(CATALOG_PATH, idx * sizeof(CatalogRec), (const uint8_t*)&r, sizeof(r));
+}
+
+static void save_cursor(bool force) {
+    if (s_upl_cursor == s_upl_saved) return;
+    if (!force && millis() - s_upl_save_ms < NVS_MIN_SAVE_INTERVAL_MS) return;
+    Preferences p;
+    if (!p.begin("cat", false)) return;
+    p.putUInt("upl", s_upl_cursor);
+    p.end();
+    s_upl_saved = s_upl_cursor;
+    s_upl_save_ms = millis();
+}
+
+bool catalog_init() {
+    if (!SD.exists(CATALOG_DIR) && !SD.mkdir(CATALOG_DIR)) return false;
+    s_count = 0;
+    File f = SD.open(CATALOG_PATH, FILE_READ);
+    if (f) {
+        // 尾部撕裂的记录丢弃（下次写入覆盖）
+        uint32_t n = f.size() / sizeof(CatalogRec);
+        CatalogRec r;
+        while (n > 0 && !read_rec_sd(f, n - 1, r)) n--;
+        s_count = n;
+        uint32_t first = n > CATALOG_TAIL ? n - CATALOG_TAIL : 0;
+        for (uint32_t i = first; i < n; i++) {
+            if (!read_rec_sd(f, i, s_tail[i % CATALOG_TAIL])) memset(&s_tail[i % CATALOG_TAIL], 0, sizeof(CatalogRec));
+        }
+        f.close();
+    }
+    Preferences p;
+    if (p.begin("cat", true)) {
+        s_upl_cursor = p.getUInt("upl", 0);
+        p.end();
+    }
+    if (s_upl_cursor > s_count) s_upl_cursor = s_count;
+    s_upl_saved = s_upl_cursor;
+    s_ready = true;
+    log2Val("[CAT] Catalog records: ", (int)s_count);
+    return true;
+}
+
+uint32_t catalog_count() { return s_count; }
+
+int32_t catalog_add(const char* name, uint32_t epoch, uint32_t len) {
+    if (!s_ready || !name) return -1;
+    CatalogRec r;
+    memset(&r, 0, sizeof(r));
+    r.epoch = epoch;
+    r.len = len;
+    strncpy(r.name, name, sizeof(r.name) - 1);
+    r.crc = rec_crc(r);
+    if (!write_rec(s_count, r)) return -1;
+    s_tail[s_count % CATALOG_TAIL] = r;
+    return (int32_t)s_count++;
+}
+
+bool catalog_get(uint32_t idx, CatalogRec& out) {
+    if (!s_ready || idx >= s_count) return false;
+    if (in_tail(idx)) { out = s_tail[idx % CATALOG_TAIL]; return true; }
+    File f = SD.open(CATALOG_PATH, FILE_READ);
+    if (!f) return false;
+    bool ok = read_rec_sd(f, idx, out);
+    f.close();
+    return ok;
+}
+
+bool catalog_set_flags(uint32_t idx, uint16_t set) {
+    CatalogRec r;
+    if (!catalog_get(idx, r)) return false;
+    if ((r.flags & set) == set) return true;
+    r.flags |= set;
+    r.crc = rec_crc(r);
+    if (!write_rec(idx, r)) return false;
+    if (in_tail(idx)) s_tail[idx % CATALOG_TAIL] = r;
+    return true;
+}
+
+uint32_t catalog_scan(uint32_t first, uint32_t n, CatalogVisitFn fn, void* ctx) {
+    if (!s_ready || !fn) return first;
+    File f;
+    uint32_t i = first;
+    while (i < s_count && i - first < n) {
+        CatalogRec r;
+        bool ok;
+        if (in_tail(i)) { r = s_tail[i % CATALOG_TAIL]; ok = true; }
+        else {
+            if (!f) f = SD.open(CATALOG_PATH, FILE_READ);
+            ok = f && read_rec_sd(f, i, r);
+        }
+        uint32_t idx = i++;
+        if (ok && !fn(idx, r, ctx)) break;
+    }
+    if (f) f.close();
+    return i;
+}
+
+int32_t catalog_find_recent(const char* name, uint32_t window) {
+    if (!s_ready || !name || !name[0]) return -1;
+    if (window > s_count) window = s_count;
+    const uint32_t stop = s_count - window;
+    uint32_t i = s_count;
+    // 内存尾部先查，新->旧
+    while (i > stop && in_tail(i - 1)) {
+        i--;
+        if (strncmp(s_tail[i % CATALOG_TAIL].name, name, sizeof(s_tail[0].name)) == 0) return (int32_t)i;
+    }
+    if (i == stop) return -1;
+    // 更早的记录：只开一次文件，按块倒着读
+    File f = SD.open(CATALOG_PATH, FILE_READ);
+    if (!f) return -1;
+    static CatalogRec blk[CATALOG_FIND_BLOCK];   // 仅主循环调用
+    int32_t found = -1;
+    while (i > stop && found < 0) {
+        uint32_t n = i - stop < CATALOG_FIND_BLOCK ? i - stop : CATALOG_FIND_BLOCK;
+        uint32_t first = i - n;
+        size_t bytes = n * sizeof(CatalogRec);
+        if (!f.seek(first * sizeof(CatalogRec)) || f.read((uint8_t*)blk, bytes) != bytes) break;
+        for (uint32_t k = n; k-- > 0;) {
+            if (strncmp(blk[k].name, name, sizeof(blk[k].name)) == 0 && blk[k].crc == rec_crc(blk[k])) {
+                found = (int32_t)(first + k);
+                break;
+            }
+        }
+        i = first;
+    }
+    f.close();
+    return found;
+}
+
+// 全目录查找（跨轮转遗留的孤儿可能很旧），找不到记日志
+static bool mark_flags(const char* name, uint16_t set) {
+    int32_t idx = catalog_find_recent(name, s_count);
+    if (idx < 0) {
+        log2Str("[CAT] Record not found: ", name ? name : "");
+        return false;
+    }
+    if (!catalog_set_flags((uint32_t)idx, set)) {
+        log2Str("[CAT] Flag write failed: ", name);
+        return false;
+    }
+    return true;
+}
+
+bool catalog_mark_uploaded(const char* name) {
+    return mark_flags(name, CAT_F_UPLOADED);
+}
+
+bool catalog_mark_deleted(const char* name) {
+    return mark_flags(name, CAT_F_DELETED);
+}
+
+uint32_t catalog_latest(uint32_t n, uint32_t* idxs) {
+    if (!idxs) return 0;
+    if (n > s_count) n = s_count;
+    for (uint32_t k = 0; k < n; k++) idxs[k] = s_count - 1 - k;
+    return n;
+}
+
+// 记录按保存顺序追加，时间基本单调：二分定位第一条 epoch>=t0 的记录，再顺序读到 t1。
+// 未校时记录（epoch=0）二分时向后跳过
+uint32_t catalog_range(uint32_t t0, uint32_t t1, uint32_t* idxs, uint32_t max) {
+    if (!s_ready || !idxs || max == 0 || s_count == 0) return 0;
+    File f = SD.open(CATALOG_PATH, FILE_READ);
+    CatalogRec r;
+    auto get = [&](uint32_t i) -> bool {
+        if (in_tail(i)) { r = s_tail[i % CATALOG_TAIL]; return true; }
+        return f && read_rec_sd(f, i, r);
+    };
+    uint32_t lo = 0, hi = s_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2, m = mid;
+        while (m < hi && get(m) && r.epoch == 0) m++;
+        if (m >= hi) { hi = mid; continue; }
+        if (r.epoch < t0) lo = m + 1; else hi = mid;
+    }
+    uint32_t found = 0;
+    for (uint32_t i = lo; i < s_count && found < max; i++) {
+        if (!get(i) || r.epoch == 0) continue;
+        if (r.epoch > t1) break;
+        if (r.epoch >= t0 && !(r.flags & CAT_F_DELETED)) idxs[found++] = i;
+    }
+    if (f) f.close();
+    return found;
+}
+
+uint32_t catalog_pending_upload(uint32_t* idxs, uint32_t max) {
+    if (!s_ready || !idxs || max == 0) return 0;
+    uint32_t found = 0;
+    bool leading = true;   // 游标之后连续已完成的记录：推进游标
+    File f;
+    for (uint32_t i = s_upl_cursor; i < s_count && found < max; i++) {
+        CatalogRec r;
+        bool ok;
+        if (in_tail(i)) { r = s_tail[i % CATALOG_TAIL]; ok = true; }
+        else {
+            if (!f) f = SD.open(CATALOG_PATH, FILE_READ);
+            ok = f && read_rec_sd(f, i, r);
+        }
+        bool done = !ok || (r.flags & (CAT_F_UPLOADED | CAT_F_DELETED));
+        if (done) {
+            if (leading) s_upl_cursor = i + 1;
+            continue;
+        }
+        leading = false;
+        idxs[found++] = i;
+    }
+    if (f) f.close();
+    save_cursor(false);
+    return found;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// 照片目录（on-card catalog）：CATALOG_PATH 中的定长记录，按保存顺序追加，记录号即下标。
+// 与写入同步维护（经 sd_async 定位写），查询按下标直接定位，不扫描目录
+#define CAT_F_UPLOADED 0x01   // 已上传
+#define CAT_F_DELETED  0x02   // 已被保留策略删除
+
+struct CatalogRec {
+    uint32_t epoch;      // 拍摄时间（UTC秒，RTC未校时为0）
+    uint32_t len;        // 字节数
+    uint16_t flags;      // CAT_F_*
+    uint16_t crc;        // 其余字段的 CRC16（计算时 crc 置0）
+    char     name[52];   // 文件路径或 imgstore:// 逻辑名
+} __attribute__((packed));
+
+bool catalog_init();
+uint32_t catalog_count();
+
+// 记录一张已提交保存的照片，返回记录号（失败返回-1）
+int32_t catalog_add(const char* name, uint32_t epoch, uint32_t len);
+bool catalog_get(uint32_t idx, CatalogRec& out);
+bool catalog_set_flags(uint32_t idx, uint16_t set);
+
+// 顺序遍历 [first, first+n)：只打开一次目录文件；读坏的记录跳过。fn 返回 false 停止，返回下一条记录号
+typedef bool (*CatalogVisitFn)(uint32_t idx, const CatalogRec& r, void* ctx);
+uint32_t catalog_scan(uint32_t first, uint32_t n, CatalogVisitFn fn, void* ctx);
+
+// 在最近 window 条记录中按名字查找，新->旧，未找到返回-1
+int32_t catalog_find_recent(const char* name, uint32_t window);
+// 回写标志：查找范围为整个目录，找不到或写失败记日志并返回false
+bool catalog_mark_uploaded(const char* name);
+bool catalog_mark_deleted(const char* name);    // 文件已不可用（掉电半截被隔离等），不再上传
+
+// 查询：结果为记录号
+uint32_t catalog_latest(uint32_t n, uint32_t* idxs);                               // 最新n条，新->旧
+uint32_t catalog_range(uint32_t t0, uint32_t t1, uint32_t* idxs, uint32_t max);   // 时间范围，旧->新
+uint32_t catalog_pending_upload(uint32_t* idxs, uint32_t max);                     // 未上传且未删除，旧->新
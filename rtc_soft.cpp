@@ -1,137 +1,178 @@
-#include "rtc_soft.h"
-#include <Arduino.h>
-#include "config.h"
-
-static bool s_valid = false;
-static uint32_t s_base_epoch = 0;      // 上次校时的UTC秒（UNIX epoch）
-static uint32_t s_base_millis = 0;     // 上次校时时的millis
-
-// 闰年判断（公历规则）
-static inline bool isLeap(uint32_t y) {
-    return ( (y % 4 == 0) && (y % 100 != 0) ) || (y % 400 == 0);
-}
-
-static inline uint8_t daysInMonth(uint32_t y, uint8_t m) {
-    static const uint8_t mdays[12] = {31,28,31,30,31,30,31,31,30,31,30,31};
-    if (m == 2) return mdays[1] + (isLeap(y) ? 1 : 0);
-    return mdays[m - 1];
-}
-
-// 平台时间（YYYY/MM/DD hh:mm:ss）转 UNIX epoch 秒（UTC）
-// 注意：这里按 2000-01-01 为参考加上 946684800 偏移，与你原来的算法一致
-static uint32_t platformTimeToEpoch(const PlatformTime* t) {
-    uint16_t year = t->year;
-    uint8_t month = t->month;
-    uint8_t day = t->day;
-    uint8_t hour = t->hour;
-    uint8_t minute = t->minute;
-    uint8_t second = t->second;
-
-    // 计算从 2000-01-01 到指定日期的天数
-    // 更稳妥的做法：逐年逐月累加，避免简化闰年误差
-    uint32_t days = 0;
-
-    // 加上从 2000 到 year-1 的整年天数
-    for (uint32_t y = 2000; y < year; ++y) {
-        days += isLeap(y) ? 366 : 365;
-    }
-    // 加上 year 年内从 1 月到 month-1 月的整月天数
-    for (uint8_t m = 1; m < month; ++m) {
-        days += daysInMonth(year, m);
-    }
-    // 加上当月天数（从 1 号到 day-1）
-    days += (uint32_t)(day - 1);
-
-    uint32_t seconds = days * 86400UL + hour * 3600UL + minute * 60UL + second;
-
-    // 2000-01-01 到 1970-01-01 的秒数偏移：946684800
-    return seconds + 946684800UL;
-}
-
-// UNIX epoch → 年月日时分秒（UTC）
-static void epochToFields(uint32_t epoch, PlatformTime* out) {
-    // 先取出一天内的时分秒
-    uint32_t secsInDay = epoch % 86400UL;
-    out->hour   = (uint8_t)(secsInDay / 3600UL);
-    secsInDay  %= 3600UL;
-    out->minute = (uint8_t)(secsInDay / 60UL);
-    out->second = (uint8_t)(secsInDay % 60UL);
-
-    // 计算天数（从 1970-01-01 起的天数）
-    uint32_t days = epoch / 86400UL;
-
-    // 推算年份
-    uint32_t y = 1970;
-    while (true) {
-        uint32_t dy = isLeap(y) ? 366 : 365;
-        if (days >= dy) {
-            days -= dy;
-            ++y;
-        } else {
-            break;
-        }
-    }
-    out->year = (uint16_t)y;
-
-    // 推算月份
-    uint8_t m = 1;
-    while (true) {
-        uint8_t dm = daysInMonth(y, m);
-        if (days >= dm) {
-            days -= dm;
-            ++m;
-        } else {
-            break;
-        }
-    }
-    out->month = m;
-    out->day   = (uint8_t)(days + 1);
-}
-
-void rtc_init() {
-    // 目前无初始化内容
-}
-
-bool rtc_is_valid() {
-    return s_valid;
-}
-
-// 当前 UNIX epoch（秒）
-uint32_t rtc_now() {
-    if (!s_valid) return 0;
-    uint32_t now_millis = millis();
-    uint32_t delta_ms = now_millis - s_base_millis;
-    return s_base_epoch + (delta_ms / 1000UL);
-}
-
-// 当前 UTC 时间（YYYY-MM-DD hh:mm:ss）
-void rtc_now_fields(PlatformTime* out) {
-    if (!s_valid) {
-        out->year = 1970; out->month = 1; out->day = 1;
-        out->hour = 0; out->minute = 0; out->second = 0;
-        return;
-    }
-    uint32_t t = rtc_now();
-    epochToFields(t, out);
-}
-
-// 校时：收到平台时间包后调用
-void rtc_on_sync(const PlatformTime* plat, uint32_t recv_millis) {
-    s_base_epoch = platformTimeToEpoch(plat);
-    s_base_millis = recv_millis;
-    s_valid = true;
-
-#if ENABLE_LOG2
-    Serial2.print("[RTC] Sync OK: ");
-    Serial2.print(plat->year); Serial2.print("-");
-    Serial2.print((int)plat->month); Serial2.print("-");
-    Serial2.print((int)plat->day); Serial2.print(" ");
-    Serial2.print((int)plat->hour); Serial2.print(":");
-    Serial2.print((int)plat->minute); Serial2.print(":");
-    Serial2.print((int)plat->second);
-    Serial2.print(" (millis=");
-    Serial2.print(recv_millis);
-    Serial2.println(")");
-    Serial2.println("[RTC] RTC is now valid, uploading enabled.");
-#endif
+#include "rtc_soft.h"
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "config.h"
+#include "civil_date.h"
+
+static bool s_valid = false;
+static uint64_t s_base_epoch_ms = 0;   // 上次校时的UTC毫秒（UNIX epoch）
+static uint64_t s_base_mono_ms = 0;    // 上次校时时的单调毫秒
+
+// 漂移估计：以锚点（首次/时间跳变后的第一次校时）为起点，基线越长估计越准
+static bool     s_anchor = false;
+static uint64_t s_anchor_epoch_ms = 0;
+static uint64_t s_anchor_mono_ms = 0;
+static int32_t  s_drift_ppb = 0;                              // 本地时钟相对平台时间的快慢（十亿分之一，正=本地偏慢）
+static uint32_t s_unc_ppb = (uint32_t)RTC_DRIFT_MAX_PPM * 1000;  // 漂移估计的不确定度
+static uint8_t  s_outlier_run = 0;
+static RtcSyncStats s_stats = {0, 0, 0, 0, 0};
+
+// 64位单调毫秒：esp_timer 为64位微秒计数，不存在 millis() 约49.7天回绕的问题
+static inline uint64_t mono_ms() {
+    return (uint64_t)(esp_timer_get_time() / 1000);
+}
+
+// 把32位 millis() 时刻换算到64位时基：取它与当前 millis() 的差（模2^32，按不超过49天计）
+static inline uint64_t mono_from_millis(uint32_t m) {
+    uint64_t now = mono_ms();
+    uint32_t ago = (uint32_t)now - m;
+    return now - ago;
+}
+
+// 平台时间（YYYY/MM/DD hh:mm:ss）转 UNIX epoch 秒（UTC）
+static uint32_t platformTimeToEpoch(const PlatformTime* t) {
+    int32_t days = days_from_civil(t->year, t->month, t->day);
+    return (uint32_t)days * 86400UL + t->hour * 3600UL + t->minute * 60UL + t->second;
+}
+
+// UNIX epoch → 年月日时分秒（UTC）
+static void epochToFields(uint32_t epoch, PlatformTime* out) {
+    uint32_t secsInDay = epoch % 86400UL;
+    out->hour   = (uint8_t)(secsInDay / 3600UL);
+    secsInDay  %= 3600UL;
+    out->minute = (uint8_t)(secsInDay / 60UL);
+    out->second = (uint8_t)(secsInDay % 60UL);
+
+    int32_t y;
+    uint32_t m, d;
+    civil_from_days((int32_t)(epoch / 86400UL), &y, &m, &d);
+    out->year  = (uint16_t)y;
+    out->month = (uint8_t)m;
+    out->day   = (uint8_t)d;
+}
+
+void rtc_init() {
+    // 目前无初始化内容
+}
+
+bool rtc_is_valid() {
+    return s_valid;
+}
+
+// 按漂移估计修正后的 epoch 毫秒
+static uint64_t epoch_at(uint64_t mono) {
+    int64_t el = (int64_t)(mono - s_base_mono_ms);
+    return s_base_epoch_ms + el + el * s_drift_ppb / 1000000000LL;
+}
+
+// 误差上界：校时本身的误差（平台时间只到秒+链路延迟）+ 漂移不确定度随时间的累积
+static uint32_t error_at(uint64_t mono) {
+    uint64_t el = mono - s_base_mono_ms;
+    return RTC_SYNC_ERR_MS + (uint32_t)(el * s_unc_ppb / 1000000000ULL);
+}
+
+// 当前 UNIX epoch（毫秒）
+uint64_t rtc_now_ms() {
+    if (!s_valid) return 0;
+    return epoch_at(mono_ms());
+}
+
+uint32_t rtc_error_ms() {
+    if (!s_valid) return 0xFFFFFFFFu;
+    return error_at(mono_ms());
+}
+
+// 误差上界超出容差才需要校时；漂移估计再好也至少每 RTC_SYNC_MAX_INTERVAL_MS 校一次
+bool rtc_needs_sync() {
+    if (!s_valid) return true;
+    uint64_t mono = mono_ms();
+    return error_at(mono) > RTC_SYNC_TOLERANCE_MS || mono - s_base_mono_ms > RTC_SYNC_MAX_INTERVAL_MS;
+}
+
+void rtc_get_sync_stats(RtcSyncStats& out) {
+    out = s_stats;
+    out.drift_ppb = s_drift_ppb;
+    out.unc_ppb = s_unc_ppb;
+}
+
+// 当前 UNIX epoch（秒）
+uint32_t rtc_now() {
+    return (uint32_t)(rtc_now_ms() / 1000ULL);
+}
+
+// 当前 UTC 时间（YYYY-MM-DD hh:mm:ss）
+void rtc_now_fields(PlatformTime* out) {
+    if (!s_valid) {
+        out->year = 1970; out->month = 1; out->day = 1;
+        out->hour = 0; out->minute = 0; out->second = 0;
+        return;
+    }
+    uint32_t t = rtc_now();
+    epochToFields(t, out);
+}
+
+// 时间跳变（平台改时、长时间断电后首次校时）：漂移估计从头开始
+static void reset_drift(uint64_t epoch_ms, uint64_t mono) {
+    s_anchor = true;
+    s_anchor_epoch_ms = epoch_ms;
+    s_anchor_mono_ms = mono;
+    s_drift_ppb = 0;
+    s_unc_ppb = (uint32_t)RTC_DRIFT_MAX_PPM * 1000;
+}
+
+// 用锚点到本次校时的整段基线估计漂移：两端各有 RTC_SYNC_ERR_MS 的误差，基线越长影响越小
+static void update_drift(uint64_t epoch_ms, uint64_t mono) {
+    int64_t local = (int64_t)(mono - s_anchor_mono_ms);
+    if (local < (int64_t)RTC_DRIFT_MIN_BASELINE_MS) return;
+    int64_t ref = (int64_t)(epoch_ms - s_anchor_epoch_ms);
+    int64_t ppb = (ref - local) * 1000000000LL / local;
+    if (ppb > (int64_t)RTC_DRIFT_MAX_PPM * 1000 || ppb < -(int64_t)RTC_DRIFT_MAX_PPM * 1000) return;   // 超出晶振可能范围，不采信
+    uint64_t unc = (uint64_t)RTC_DRIFT_FLOOR_PPM * 1000 + 2ULL * RTC_SYNC_ERR_MS * 1000000000ULL / (uint64_t)local;
+    if (unc < s_unc_ppb) {
+        s_drift_ppb = (int32_t)ppb;
+        s_unc_ppb = (uint32_t)unc;
+    }
+}
+
+// 校时：收到平台时间包后调用。与当前估计的偏差超出误差上界的视为离群（链路异常延迟等）丢弃，
+// 连续 RTC_OUTLIER_ACCEPT_AFTER 次离群则认为平台时间确实跳变，接受并重估漂移
+void rtc_on_sync(const PlatformTime* plat, uint32_t recv_millis) {
+    uint64_t epoch_ms = (uint64_t)platformTimeToEpoch(plat) * 1000ULL;
+    uint64_t mono = mono_from_millis(recv_millis);
+    s_stats.syncs++;
+    if (s_valid) {
+        int64_t resid = (int64_t)(epoch_ms - epoch_at(mono));
+        int64_t limit = (int64_t)error_at(mono) + RTC_OUTLIER_MARGIN_MS;
+        s_stats.last_resid_ms = (int32_t)resid;
+        if (resid > limit || resid < -limit) {
+            s_stats.outliers++;
+            if (++s_outlier_run < RTC_OUTLIER_ACCEPT_AFTER) {
+                log2Val("[RTC] Sync rejected as outlier, resid ms: ", (int)resid);
+                return;
+            }
+            reset_drift(epoch_ms, mono);
+        } else {
+            update_drift(epoch_ms, mono);
+        }
+    } else if (!s_anchor) {
+        reset_drift(epoch_ms, mono);
+    }
+    s_outlier_run = 0;
+    s_base_epoch_ms = epoch_ms;
+    s_base_mono_ms = mono;
+    s_valid = true;
+
+#if ENABLE_LOG2
+    Serial2.print("[RTC] Sync OK: ");
+    Serial2.print(plat->year); Serial2.print("-");
+    Serial2.print((int)plat->month); Serial2.print("-");
+    Serial2.print((int)plat->day); Serial2.print(" ");
+    Serial2.print((int)plat->hour); Serial2.print(":");
+    Serial2.print((int)plat->minute); Serial2.print(":");
+    Serial2.print((int)plat->second);
+    Serial2.print(" (millis=");
+    Serial2.print(recv_millis);
+    Serial2.println(")");
+    Serial2.println("[RTC] RTC is now valid, uploading enabled.");
+#endif
 }
\ No newline at end of file
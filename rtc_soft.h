@@ -1,18 +1,34 @@
-#pragma once
-#include <stdint.h>
-#include "uart_utils.h"
-
-// 软件RTC初始化（可选，通常自动完成）
-void rtc_init();
-
-// 是否已获得有效时间（首次校时成功后为true）
-bool rtc_is_valid();
-
-// 获取当前UTC时间（秒，1970纪元）
-uint32_t rtc_now();
-
-// 获取当前UTC时间（年月日时分秒，UTC，输出到PlatformTime结构体）
-void rtc_now_fields(PlatformTime* out);
-
-// 校时接口：收到新的平台时间包后调用（传入PlatformTime和本地接收时的millis）
-void rtc_on_sync(const PlatformTime* plat, uint32_t recv_millis);
+#pragma once
+#include <stdint.h>
+#include "uart_utils.h"
+
+// 软件RTC初始化（可选，通常自动完成）
+void rtc_init();
+
+// 是否已获得有效时间（首次校时成功后为true）
+bool rtc_is_valid();
+
+// 获取当前UTC时间（秒，1970纪元）
+uint32_t rtc_now();
+
+// 获取当前UTC时间（毫秒，1970纪元；64位时基，不受 millis() 回绕影响）
+uint64_t rtc_now_ms();
+
+// 获取当前UTC时间（年月日时分秒，UTC，输出到PlatformTime结构体）
+void rtc_now_fields(PlatformTime* out);
+
+// 校时接口：收到新的平台时间包后调用（传入PlatformTime和本地接收时的millis）
+void rtc_on_sync(const PlatformTime* plat, uint32_t recv_millis);
+
+// 漂移补偿：由相邻校时估计本地时钟快慢（ppb）并持续修正；误差上界超过 RTC_SYNC_TOLERANCE_MS 时才需校时
+struct RtcSyncStats {
+    uint32_t syncs;          // 收到的校时包
+    uint32_t outliers;       // 被判为离群的校时包
+    int32_t  drift_ppb;      // 当前漂移估计（正=本地偏慢）
+    uint32_t unc_ppb;        // 漂移估计的不确定度
+    int32_t  last_resid_ms;  // 最近一次校时与估计值之差
+};
+
+uint32_t rtc_error_ms();     // 当前时间的估计误差上界（未校时返回 0xFFFFFFFF）
+bool rtc_needs_sync();       // 是否该发校时请求
+void rtc_get_sync_stats(RtcSyncStats& out);
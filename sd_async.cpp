@@ -1,251 +1,1193 @@
-#include "sd_async.h"
-#include "config.h"
-#include <SD.h>
-#include <FS.h>
-
-#if !ASYNC_SD_ENABLE
-// 关闭时提供空实现
-bool sd_async_init(){ return true; }
-bool sd_async_start(){ return true; }
-void sd_async_stop(bool){ }
-bool sd_async_on_sd_ready(){ return true; }
-void sd_async_on_sd_lost(){ }
-bool sd_async_submit(const char*, const uint8_t*, size_t, uint32_t){ return false; }
-bool sd_async_flush(uint32_t){ return true; }
-void sd_async_get_stats(SdAsyncStats& out){ memset(&out,0,sizeof(out)); }
-bool sd_async_idle(){ return true; }
-
-#else
-
-#include <freertos/FreeRTOS.h>
-#include <freertos/queue.h>
-#include <freertos/task.h>
-#include <freertos/semphr.h>
-#include <esp_heap_caps.h>
-
-struct PoolBlk {
-  PoolBlk* next;
-  size_t   cap;
-  size_t   len;
-  uint8_t  data[0];
-};
-
-struct Job {
-  char     path[ASYNC_SD_MAX_PATH];
-  PoolBlk* blk;
-  bool     is_first;  // 第一块：会先 remove 旧文件
-};
-
-static QueueHandle_t  g_q = nullptr;
-static TaskHandle_t   g_task = nullptr;
-static SemaphoreHandle_t g_mtx = nullptr;
-
-static PoolBlk** g_pool = nullptr;     // 便于统计
-static PoolBlk*  g_free = nullptr;
-static uint32_t  g_pool_total = 0;
-
-static volatile bool g_running = false;
-static volatile bool g_sd_ready = false;
-static volatile uint32_t g_enq_ok = 0;
-static volatile uint32_t g_enq_drop = 0;
-static volatile uint32_t g_wr_ok = 0;
-static volatile uint32_t g_wr_fail = 0;
-static volatile uint32_t g_q_max = 0;
-static volatile bool g_writer_busy = false;
-
-static void pool_init(){
-  g_pool_total = 0;
-  g_free = nullptr;
-  if(!g_pool){
-    g_pool = (PoolBlk**)calloc(ASYNC_SD_POOL_BLOCKS, sizeof(PoolBlk*));
-  }
-  for(uint32_t i=0;i<ASYNC_SD_POOL_BLOCKS;i++){
-    size_t alloc_size = sizeof(PoolBlk) + ASYNC_SD_POOL_BLOCK_SIZE;
-    void* mem = heap_caps_malloc(alloc_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    if(!mem) mem = heap_caps_malloc(alloc_size, MALLOC_CAP_8BIT);
-    if(!mem){
-      continue;
-    }
-    PoolBlk* b = (PoolBlk*)mem;
-    b->cap = ASYNC_SD_POOL_BLOCK_SIZE;
-    b->len = 0;
-    b->next = g_free;
-    g_free = b;
-    g_pool[i] = b;
-    g_pool_total++;
-  }
-}
-
-static PoolBlk* pool_take(){
-  PoolBlk* b = nullptr;
-  xSemaphoreTake(g_mtx, portMAX_DELAY);
-  if(g_free){ b = g_free; g_free = g_free->next; b->next=nullptr; b->len=0; }
-  xSemaphoreGive(g_mtx);
-  return b;
-}
-
-static void pool_give(PoolBlk* b){
-  if(!b) return;
-  xSemaphoreTake(g_mtx, portMAX_DELAY);
-  b->next = g_free; g_free = b;
-  xSemaphoreGive(g_mtx);
-}
-
-static uint32_t pool_free_count(){
-  uint32_t n=0;
-  xSemaphoreTake(g_mtx, portMAX_DELAY);
-  for(PoolBlk* p=g_free;p;p=p->next) n++;
-  xSemaphoreGive(g_mtx);
-  return n;
-}
-
-static bool q_send(Job& j, uint32_t timeout_ms){
-  if(!g_q) return false;
-  if(xQueueSend(g_q, &j, pdMS_TO_TICKS(timeout_ms)) == pdTRUE){
-    g_enq_ok++;
-    uint32_t depth = uxQueueMessagesWaiting(g_q);
-    if(depth > g_q_max) g_q_max = depth;
-    return true;
-  }else{
-    g_enq_drop++;
-    return false;
-  }
-}
-
-static bool write_chunk(const char* path, const uint8_t* data, size_t len, bool is_first){
-  if(!g_sd_ready) return false;
-  if(is_first){
-    SD.remove(path);
-  }
-  File f = SD.open(path, FILE_WRITE);
-  if(!f){ return false; }
-  size_t w = f.write(data, len);
-  f.flush();
-  f.close();
-  return (w == len);
-}
-
-static void writer_task(void*){
-  Job j{};
-  while(g_running){
-    if(xQueueReceive(g_q, &j, pdMS_TO_TICKS(100)) != pdTRUE){
-      continue;
-    }
-    if(!j.blk){ continue; }
-    g_writer_busy = true;
-    bool ok = write_chunk(j.path, j.blk->data, j.blk->len, j.is_first);
-    if(ok) g_wr_ok++; else g_wr_fail++;
-    pool_give(j.blk);
-    g_writer_busy = false;
-  }
-  vTaskDelete(nullptr);
-}
-
-bool sd_async_init(){
-  if(!g_mtx) g_mtx = xSemaphoreCreateMutex();
-  pool_init();
-  if(!g_q) g_q = xQueueCreate(ASYNC_SD_QUEUE_LENGTH, sizeof(Job));
-  return (g_mtx && g_q && g_pool_total>0);
-}
-
-bool sd_async_start(){
-  if(g_task) return true;
-  g_running = true;
-  BaseType_t rc = xTaskCreatePinnedToCore(writer_task, "sdw",
-                                          ASYNC_SD_TASK_STACK, nullptr,
-                                          ASYNC_SD_TASK_PRIO, &g_task,
-                                          tskNO_AFFINITY);
-  return rc == pdPASS;
-}
-
-void sd_async_stop(bool drain){
-  if(!g_task) return;
-  if(drain){
-    uint32_t t0 = millis();
-    while((uxQueueMessagesWaiting(g_q) > 0 || g_writer_busy) &&
-          (millis() - t0 < ASYNC_SD_FLUSH_TIMEOUT_MS)){
-      vTaskDelay(pdMS_TO_TICKS(10));
-    }
-  }
-  g_running = false;
-  Job j{}; xQueueSend(g_q, &j, 0);
-  vTaskDelay(pdMS_TO_TICKS(50));
-  g_task = nullptr;
-}
-
-bool sd_async_on_sd_ready(){
-  g_sd_ready = true;
-  return true;
-}
-
-void sd_async_on_sd_lost(){
-  g_sd_ready = false;
-}
-
-bool sd_async_submit(const char* path, const uint8_t* data, size_t len, uint32_t timeout_ms){
-  if(!path || !data || len==0) return false;
-  if(!g_q || !g_pool_total) return false;
-
-  size_t remain = len;
-  size_t offset = 0;
-  bool   first  = true;
-  while(remain){
-    size_t chunk = remain;
-    if(chunk > ASYNC_SD_POOL_BLOCK_SIZE) chunk = ASYNC_SD_POOL_BLOCK_SIZE;
-
-    PoolBlk* b = pool_take();
-    if(!b){
-      if(timeout_ms == 0) return false;
-      vTaskDelay(pdMS_TO_TICKS(timeout_ms));
-      b = pool_take();
-      if(!b) return false;
-    }
-    memcpy(b->data, data + offset, chunk);
-    b->len = chunk;
-
-    Job j{};
-    strncpy(j.path, path, ASYNC_SD_MAX_PATH-1);
-    j.path[ASYNC_SD_MAX_PATH-1] = '\0';
-    j.blk = b;
-    j.is_first = first;
-    first = false;
-
-    if(!q_send(j, timeout_ms)){
-      pool_give(b);
-      return false;
-    }
-
-    offset += chunk;
-    remain -= chunk;
-  }
-  return true;
-}
-
-bool sd_async_flush(uint32_t timeout_ms){
-  uint32_t t0 = millis();
-  while((uxQueueMessagesWaiting(g_q) > 0 || g_writer_busy) &&
-        (millis() - t0 < timeout_ms)){
-    vTaskDelay(pdMS_TO_TICKS(10));
-  }
-  return (uxQueueMessagesWaiting(g_q) == 0 && !g_writer_busy);
-}
-
-void sd_async_get_stats(SdAsyncStats& out){
-  out.enq_ok = g_enq_ok;
-  out.enq_drop = g_enq_drop;
-  out.write_ok = g_wr_ok;
-  out.write_fail = g_wr_fail;
-  out.pool_total = g_pool_total;
-  out.pool_free = pool_free_count();
-  out.q_depth = g_q ? uxQueueMessagesWaiting(g_q) : 0;
-  out.q_max = g_q_max;
-  out.running = g_running;
-  out.sd_ready = g_sd_ready;
-  out.task_stack_min = g_task ? uxTaskGetStackHighWaterMark(g_task) : 0;
-}
-
-bool sd_async_idle(){
-  return (uxQueueMessagesWaiting(g_q) == 0 && !g_writer_busy);
-}
-
+#include "sd_async.h"
+#include "config.h"
+#include "sdcard_module.h"
+#include "crc16.h"
+#include <SD.h>
+#include <FS.h>
+
+#if !ASYNC_SD_ENABLE
+// 关闭时提供空实现
+bool sd_async_init(){ return true; }
+bool sd_async_start(){ return true; }
+void sd_async_stop(bool){ }
+bool sd_async_on_sd_ready(){ return true; }
+void sd_async_on_sd_lost(){ }
+bool sd_async_submit(const char*, const uint8_t*, size_t, uint32_t){ return false; }
+bool sd_async_submit_at(const char*, uint32_t, const uint8_t*, size_t, uint32_t){ return false; }
+bool sd_async_submit_ex(const char*, uint32_t, const uint8_t*, size_t, const SdAsyncAdmit&, SdAsyncPressure* bp){
+  if(bp) *bp = SD_ASYNC_BP_FULL;
+  return false;
+}
+SdAsyncPressure sd_async_pressure(size_t, uint8_t){ return SD_ASYNC_BP_FULL; }
+bool sd_async_flush(uint32_t){ return true; }
+void sd_async_get_stats(SdAsyncStats& out){ out = SdAsyncStats(); }
+bool sd_async_idle(){ return true; }
+uint32_t sd_async_benchmark(size_t){ return 0; }
+uint32_t sd_async_recover(void (*)(const char*)){ return 0; }
+uint32_t sd_async_hist_percentile(const uint32_t*, uint8_t){ return 0; }
+int sd_async_read(const char*, uint32_t, SdAsyncReadCb, void*, uint32_t){ return -1; }
+void sd_async_read_cancel(int){ }
+uint32_t sd_async_poll(){ return 0; }
+bool sd_async_append(const char*, const void*, size_t, uint8_t){ return false; }
+bool sd_async_append_flush(const char*){ return true; }
+
+#else
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <esp_heap_caps.h>
+#include <atomic>
+
+#define BLK_OP_WRITE 0
+#define BLK_OP_READ  1
+
+// 块头即任务描述：路径、首/末块标志随块一起传递，环里只传指针
+struct PoolBlk {
+  size_t   cap;
+  size_t   len;       // 写：数据长度；读：请求长度，完成后为实际读到的长度
+  uint8_t  cls;       // 所属尺寸类
+  uint8_t  op;        // BLK_OP_*
+  uint8_t  stream;    // 读：所属读流
+  int8_t   status;    // 读：SD_ASYNC_RD_*
+  bool     is_first;  // 第一块：按 offset 打开/定位
+  bool     is_last;   // 最后一块：整文件写完 flush+close；定位写只 flush、保留句柄
+  uint32_t offset;    // 首块写入位置：SD_ASYNC_OFF_TRUNC / SD_ASYNC_OFF_APPEND / 绝对偏移；读：文件偏移
+  uint32_t total;     // 整个提交的字节数（首块有效，写日志意图记录用）；读：完成后为文件大小
+  uint32_t deadline;  // 首块有效：超过此 millis() 仍未开写则整个任务丢弃，0=不限
+  uint8_t  prio;      // SD_ASYNC_PRIO_*，决定进哪个任务环
+  uint32_t enq_us;    // 入队时刻（micros），排队等待直方图用
+  char     path[ASYNC_SD_MAX_PATH];
+  uint8_t  data[0];
+};
+
+// 单生产者/单消费者无锁环（容量为2的幂）。
+// 任务环（每个优先级一个）：主循环提交 -> 写任务；空闲环：写任务归还 -> 主循环取用；
+// 读完成环：写任务 -> 主循环；归还环：主循环用完的读块 -> 写任务（由它放回空闲环）
+struct SpscRing {
+  PoolBlk** slot;
+  uint32_t  mask;
+  std::atomic<uint32_t> head;   // 仅生产者写
+  std::atomic<uint32_t> tail;   // 仅消费者写
+};
+
+static bool ring_init(SpscRing& r, uint32_t min_cap){
+  uint32_t cap = 1;
+  while(cap < min_cap) cap <<= 1;
+  r.slot = (PoolBlk**)calloc(cap, sizeof(PoolBlk*));
+  r.mask = cap - 1;
+  r.head.store(0);
+  r.tail.store(0);
+  return r.slot != nullptr;
+}
+
+static inline bool ring_push(SpscRing& r, PoolBlk* b){
+  uint32_t h = r.head.load(std::memory_order_relaxed);
+  if(h - r.tail.load(std::memory_order_acquire) > r.mask) return false;
+  r.slot[h & r.mask] = b;
+  r.head.store(h + 1, std::memory_order_release);
+  return true;
+}
+
+static inline PoolBlk* ring_pop(SpscRing& r){
+  uint32_t t = r.tail.load(std::memory_order_relaxed);
+  if(t == r.head.load(std::memory_order_acquire)) return nullptr;
+  PoolBlk* b = r.slot[t & r.mask];
+  r.tail.store(t + 1, std::memory_order_release);
+  return b;
+}
+
+static inline uint32_t ring_count(const SpscRing& r){
+  return r.head.load(std::memory_order_acquire) - r.tail.load(std::memory_order_acquire);
+}
+
+// 尺寸类：小/中/大三级，从同一块PSRAM arena中切出
+#define SLAB_CLASSES 3
+static const size_t   SLAB_SIZE[SLAB_CLASSES]  = { ASYNC_SD_SLAB_SMALL_SIZE, ASYNC_SD_SLAB_MID_SIZE, ASYNC_SD_POOL_BLOCK_SIZE };
+static const uint32_t SLAB_COUNT[SLAB_CLASSES] = { ASYNC_SD_SLAB_SMALL_COUNT, ASYNC_SD_SLAB_MID_COUNT, ASYNC_SD_SLAB_LARGE_COUNT };
+
+static_assert((uint64_t)ASYNC_SD_SLAB_SMALL_SIZE * ASYNC_SD_SLAB_SMALL_COUNT +
+              (uint64_t)ASYNC_SD_SLAB_MID_SIZE * ASYNC_SD_SLAB_MID_COUNT +
+              (uint64_t)ASYNC_SD_POOL_BLOCK_SIZE * ASYNC_SD_SLAB_LARGE_COUNT <=
+              (uint64_t)ASYNC_SD_POOL_BLOCK_SIZE * ASYNC_SD_POOL_BLOCKS,
+              "slab classes exceed the async SD PSRAM budget");
+
+struct SlabClass {
+  SpscRing free;
+  uint32_t total;
+  uint32_t hw;        // 同时在用的最大块数（仅取块方更新）
+  uint32_t miss;      // 本类无空闲块的次数
+};
+
+static TaskHandle_t   g_task = nullptr;
+static SpscRing       g_jobs[SD_ASYNC_PRIO_COUNT];
+
+static SpscRing       g_rd_done;
+static SpscRing       g_rd_ret;
+
+// 读流（主循环独占）：顺序读到文件末尾，最多 ASYNC_SD_READ_AHEAD 个块在途
+struct ReadStream {
+  bool          active;
+  bool          finished;   // 已回调过 EOF/ERR 或被取消，余下在途块到达后直接归还
+  uint8_t       inflight;
+  uint32_t      next;       // 下一个要请求的偏移
+  uint32_t      end;        // 读到此偏移为止
+  SdAsyncReadCb cb;
+  void*         ctx;
+  char          path[ASYNC_SD_MAX_PATH];
+};
+static ReadStream g_rs[ASYNC_SD_READ_STREAMS];
+
+// 小记录合并（主循环独占）：同一路径的追加记录先攒在内存里，
+// 攒满 ASYNC_SD_GROUP_BYTES、最早一条超过 ASYNC_SD_GROUP_MAX_MS 或显式提交时，作为一次追加写入队
+struct AppendGroup {
+  char     path[ASYNC_SD_MAX_PATH];
+  uint8_t* buf;
+  size_t   len;
+  uint32_t first_ms;   // 最早一条未提交记录的时刻
+  uint32_t used_ms;    // 最近一次追加（换槽时淘汰最久未用的）
+};
+static AppendGroup g_grp[ASYNC_SD_GROUP_SLOTS];
+static uint8_t*    g_grp_mem = nullptr;
+static volatile uint32_t g_grp_records = 0;
+static volatile uint32_t g_grp_commits = 0;
+
+// 写任务独占：读句柄（顺序预读时连续复用）
+static File     g_rd;
+static char     g_rd_path[ASYNC_SD_MAX_PATH] = {0};
+static uint32_t g_rd_last_ms = 0;
+static volatile uint64_t g_rd_bytes = 0;
+static volatile uint32_t g_rd_ops = 0;
+
+// 等空间：提交方挂在信号量上，写任务归还块后唤醒（代替固定时长的 vTaskDelay）
+static SemaphoreHandle_t g_space = nullptr;
+static volatile bool     g_space_wait = false;
+
+static uint8_t*   g_arena = nullptr;
+static SlabClass  g_slab[SLAB_CLASSES];
+static uint32_t   g_pool_total = 0;
+
+static volatile bool g_running = false;
+static volatile bool g_sd_ready = false;
+static volatile uint32_t g_enq_ok = 0;
+static volatile uint32_t g_enq_drop = 0;
+static volatile uint32_t g_wr_ok = 0;
+static volatile uint32_t g_wr_fail = 0;
+static volatile uint32_t g_wr_fail_run = 0;   // 连续写失败的任务数（任务内任一块失败即算失败）
+static bool g_job_fail = false;
+static volatile uint32_t g_q_max = 0;
+static volatile bool g_writer_busy = false;
+
+// 准入统计（主循环侧）与过期丢弃（写任务侧）
+static volatile uint32_t g_bp_high = 0;
+static volatile uint32_t g_bp_full = 0;
+static volatile uint32_t g_wait_ms_max = 0;
+static volatile uint32_t g_deadline_drop = 0;
+static int  g_cont_prio = -1;                       // 写任务：正在续写的多块任务所在环
+static bool g_skip[SD_ASYNC_PRIO_COUNT] = {false};  // 写任务：该环当前任务已过期，丢到末块为止
+static bool g_broken[SD_ASYNC_PRIO_COUNT] = {false}; // 写任务：该环当前任务已失败/被放弃，丢到末块为止
+
+// 写任务独占：当前打开的文件与合并缓冲（扇区对齐的突发写）
+static File     g_cur;
+static char     g_cur_path[ASYNC_SD_MAX_PATH] = {0};
+static uint8_t* g_wc = nullptr;
+static size_t   g_wc_len = 0;
+static bool     g_cur_ok = true;       // 本文件目前为止是否全部写成功
+static uint32_t g_cur_t0_ms = 0;       // 本文件首块开始写的时刻
+static uint32_t g_cur_last_ms = 0;     // 最近一次写入时刻（空闲超时关闭用）
+static bool     g_cur_whole = false;   // 当前句柄是整文件写（截断打开），关闭时计入单文件统计
+
+// 写日志（写任务独占）：整文件写开写前记“意图”（路径+预期长度），关闭成功后记“提交”。
+// 掉电后意图无对应提交、且文件长度不符的即为半截文件，开机隔离
+#define JRN_INTENT 1
+#define JRN_COMMIT 2
+struct JrnRec {
+  uint16_t crc;       // 其余字段的 CRC16
+  uint8_t  type;      // JRN_*
+  uint8_t  rsv;
+  uint32_t seq;
+  uint32_t len;       // 预期文件长度
+  char     path[ASYNC_SD_MAX_PATH];
+} __attribute__((packed));
+
+static File     g_jrn;
+static uint32_t g_jrn_seq = 0;
+static bool     g_cur_intent = false;   // 当前文件已记意图、尚未提交
+static volatile uint32_t g_jrn_orphans = 0;    // 本次运行中未完成的整文件写（计数）
+static JrnRec   g_jrn_last;                     // 最近一条意图
+static JrnRec   g_jrn_orph[ASYNC_SD_JOURNAL_ORPHANS];   // 尚未被同路径成功写覆盖的未完成意图，轮转时带入新日志
+static uint8_t  g_jrn_orph_n = 0;
+// 表满时写任务就地隔离最旧的一条，路径经此环交主循环回调（写任务 -> 主循环）
+static char     g_qr_path[ASYNC_SD_JOURNAL_ORPHANS][ASYNC_SD_MAX_PATH];
+static std::atomic<uint32_t> g_qr_head{0}, g_qr_tail{0};
+static void   (*g_on_partial)(const char*) = nullptr;
+static volatile uint32_t g_jrn_partial = 0;    // 隔离的半截文件数（开机恢复 + 运行中遗留表满时）
+
+// 吞吐/延迟统计（写任务更新）
+static volatile uint64_t g_bytes = 0;
+static volatile uint64_t g_io_us = 0;  // 实际 write/flush/close 耗时累计
+static volatile uint32_t g_files = 0;
+static volatile uint32_t g_file_lat_last = 0;
+static volatile uint32_t g_file_lat_max = 0;
+static volatile uint32_t g_bench_kbps = 0;
+
+// 每块的排队等待（入队->开写）与写耗时（开写->写完）分布，log2 微秒分桶（写任务更新）
+static volatile uint32_t g_wait_hist[ASYNC_SD_HIST_BUCKETS] = {0};
+static volatile uint32_t g_write_hist[ASYNC_SD_HIST_BUCKETS] = {0};
+static volatile uint32_t g_wait_max_us = 0;
+static volatile uint32_t g_write_max_us = 0;
+static volatile uint32_t g_lat_max_us = 0;     // 入队->写完
+
+// 滚动吞吐：按秒分槽累计写入字节，统计时取最近 ASYNC_SD_RATE_WINDOW_S 秒
+static volatile uint32_t g_rate_bytes[ASYNC_SD_RATE_WINDOW_S] = {0};
+static volatile uint32_t g_rate_sec[ASYNC_SD_RATE_WINDOW_S] = {0};
+
+// 提交耗时（主循环侧）
+static volatile uint32_t g_sub_last_us = 0;
+static volatile uint32_t g_sub_max_us = 0;
+static volatile uint64_t g_sub_sum_us = 0;
+static volatile uint32_t g_sub_n = 0;
+
+static inline size_t slab_stride(int c){
+  return (sizeof(PoolBlk) + SLAB_SIZE[c] + 15) & ~(size_t)15;
+}
+
+// 一次性申请arena，按类切块放入各自空闲环
+static void pool_init(){
+  if(g_arena) return;
+  size_t arena = 0;
+  for(int c=0;c<SLAB_CLASSES;c++) arena += slab_stride(c) * SLAB_COUNT[c];
+  g_arena = (uint8_t*)heap_caps_malloc(arena, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if(!g_arena) return;
+  uint8_t* p = g_arena;
+  g_pool_total = 0;
+  for(int c=0;c<SLAB_CLASSES;c++){
+    SlabClass& sc = g_slab[c];
+    sc.total = sc.hw = sc.miss = 0;
+    if(!ring_init(sc.free, SLAB_COUNT[c])) continue;
+    for(uint32_t i=0;i<SLAB_COUNT[c];i++){
+      PoolBlk* b = (PoolBlk*)p;
+      b->cap = SLAB_SIZE[c];
+      b->len = 0;
+      b->cls = (uint8_t)c;
+      ring_push(sc.free, b);
+      sc.total++;
+      g_pool_total++;
+      p += slab_stride(c);
+    }
+  }
+}
+
+static PoolBlk* slab_pop(int c){
+  SlabClass& sc = g_slab[c];
+  PoolBlk* b = ring_pop(sc.free);
+  if(!b){ sc.miss++; return nullptr; }
+  uint32_t used = sc.total - ring_count(sc.free);
+  if(used > sc.hw) sc.hw = used;
+  b->len = 0;
+  return b;
+}
+
+// 仅主循环（提交方）调用。
+// 取能装下 want 字节的最小类；都没有时退而取比 want 小的最大空闲块（调用方按 cap 切分）
+static PoolBlk* pool_take(size_t want){
+  PoolBlk* b = nullptr;
+  int c = 0;
+  while(c < SLAB_CLASSES - 1 && SLAB_SIZE[c] < want) c++;
+  for(int k=c;k<SLAB_CLASSES && !b;k++) b = slab_pop(k);
+  for(int k=c-1;k>=0 && !b;k--) b = slab_pop(k);
+  return b;
+}
+
+// 仅写任务调用（空闲环的唯一生产者）
+static void pool_give(PoolBlk* b){
+  if(!b) return;
+  ring_push(g_slab[b->cls].free, b);
+  if(g_space_wait && g_space) xSemaphoreGive(g_space);
+}
+
+static uint32_t pool_free_count(){
+  uint32_t n=0;
+  for(int c=0;c<SLAB_CLASSES;c++) n += ring_count(g_slab[c].free);
+  return n;
+}
+
+static size_t pool_free_bytes(){
+  size_t n=0;
+  for(int c=0;c<SLAB_CLASSES;c++) n += (size_t)ring_count(g_slab[c].free) * SLAB_SIZE[c];
+  return n;
+}
+
+static size_t pool_total_bytes(){
+  size_t n=0;
+  for(int c=0;c<SLAB_CLASSES;c++) n += (size_t)g_slab[c].total * SLAB_SIZE[c];
+  return n;
+}
+
+static uint32_t jobs_count(){
+  uint32_t n=0;
+  for(int p=0;p<SD_ASYNC_PRIO_COUNT;p++) n += ring_count(g_jobs[p]);
+  return n;
+}
+
+// 空闲字节数够放下 len 即可整体放下：pool_take 放不下余量时取最大的空闲块，
+// 空闲字节与剩余量同减其容量，余量始终不超过空闲字节。
+// 低优先级另须给事件照片留出 ASYNC_SD_EVENT_RESERVE
+static bool admit_fits(size_t len, uint8_t prio){
+  size_t need = len;
+  if(prio != SD_ASYNC_PRIO_EVENT) need += ASYNC_SD_EVENT_RESERVE;
+  return pool_free_bytes() >= need;
+}
+
+static SdAsyncPressure pressure_after(size_t len){
+  size_t total = pool_total_bytes(), fr = pool_free_bytes();
+  size_t used = total - fr + len;
+  return (used * 100 >= total * ASYNC_SD_BP_HIGH_PCT) ? SD_ASYNC_BP_HIGH : SD_ASYNC_BP_OK;
+}
+
+// 入队：每个任务环容量都不小于总块数，持块即有位置，不会满
+static bool q_send(PoolBlk* b){
+  SpscRing& r = g_jobs[b->prio < SD_ASYNC_PRIO_COUNT ? b->prio : SD_ASYNC_PRIO_BULK];
+  b->enq_us = micros();
+  if(!r.slot || !ring_push(r, b)){
+    g_enq_drop++;
+    return false;
+  }
+  g_enq_ok++;
+  uint32_t depth = jobs_count();
+  if(depth > g_q_max) g_q_max = depth;
+  if(g_task) xTaskNotifyGive(g_task);
+  return true;
+}
+
+static uint16_t jrn_crc(const JrnRec& r){
+  return crc16_modbus((const uint8_t*)&r + sizeof(r.crc), sizeof(r) - sizeof(r.crc));
+}
+
+static bool jrn_write(const JrnRec& r){
+  return g_jrn.write((const uint8_t*)&r, sizeof(r)) == sizeof(r);
+}
+
+// 检查一条未提交的意图：文件存在且长度不符则改名隔离（长度相符说明已写完，只是提交记录没落盘）
+static bool jrn_check(const JrnRec& r, void (*on_partial)(const char*)){
+  File f = SD.open(r.path, FILE_READ);
+  if(!f) return false;
+  uint32_t size = f.size();
+  f.close();
+  if(size == r.len) return false;
+  char q[ASYNC_SD_MAX_PATH + 8];
+  snprintf(q, sizeof(q), "%s%s", r.path, ASYNC_SD_QUARANTINE_SUFFIX);
+  SD.remove(q);
+  if(!SD.rename(r.path, q)) SD.remove(r.path);
+  if(on_partial) on_partial(r.path);
+  return true;
+}
+
+// 遗留表满：最旧的一条按开机恢复的办法当场检查，半截的改名隔离，再通知主循环
+static void jrn_evict_oldest(){
+  JrnRec r = g_jrn_orph[0];
+  g_jrn_orph_n--;
+  memmove(&g_jrn_orph[0], &g_jrn_orph[1], g_jrn_orph_n * sizeof(JrnRec));
+  if(!jrn_check(r, nullptr)) return;
+  g_jrn_partial++;
+  uint32_t h = g_qr_head.load(std::memory_order_relaxed);
+  if(h - g_qr_tail.load(std::memory_order_acquire) >= ASYNC_SD_JOURNAL_ORPHANS) return;   // 主循环跟不上：只隔离不回调
+  strncpy(g_qr_path[h % ASYNC_SD_JOURNAL_ORPHANS], r.path, ASYNC_SD_MAX_PATH);
+  g_qr_head.store(h + 1, std::memory_order_release);
+}
+
+// 当前意图（文件已打开过）未写完即结束：记入遗留表，轮转时带入新日志，开机恢复要检查它
+static void jrn_orphan(){
+  g_jrn_orphans++;
+  for(uint8_t i=0;i<g_jrn_orph_n;i++){
+    if(strcmp(g_jrn_orph[i].path, g_jrn_last.path) == 0){ g_jrn_orph[i] = g_jrn_last; return; }
+  }
+  if(g_jrn_orph_n == ASYNC_SD_JOURNAL_ORPHANS) jrn_evict_oldest();
+  g_jrn_orph[g_jrn_orph_n++] = g_jrn_last;
+}
+
+// 同一路径随后完整写成功：之前的半截已被覆盖，不必再检查
+static void jrn_resolve(const char* path){
+  for(uint8_t i=0;i<g_jrn_orph_n;){
+    if(strcmp(g_jrn_orph[i].path, path) == 0) g_jrn_orph[i] = g_jrn_orph[--g_jrn_orph_n];
+    else i++;
+  }
+}
+
+static bool jrn_append(uint8_t type, const char* path, uint32_t len){
+#if ASYNC_SD_JOURNAL_ENABLE
+  if(!g_sd_ready) return false;
+  uint32_t t0 = micros();
+  if(!g_jrn) g_jrn = SD.open(ASYNC_SD_JOURNAL_PATH, FILE_APPEND);
+  // 过长时在文件边界清空重来，遗留的未完成意图抄进新日志，开机恢复只需读一小段
+  if(g_jrn && type == JRN_INTENT && g_jrn.size() > ASYNC_SD_JOURNAL_MAX_BYTES){
+    g_jrn.close();
+    g_jrn = SD.open(ASYNC_SD_JOURNAL_PATH, FILE_WRITE);
+    for(uint8_t i=0;g_jrn && i<g_jrn_orph_n;i++) jrn_write(g_jrn_orph[i]);
+  }
+  if(!g_jrn){ g_io_us += micros() - t0; return false; }
+  JrnRec r;
+  memset(&r, 0, sizeof(r));
+  r.type = type;
+  r.seq = (type == JRN_INTENT) ? ++g_jrn_seq : g_jrn_seq;
+  r.len = len;
+  strncpy(r.path, path, ASYNC_SD_MAX_PATH-1);
+  r.crc = jrn_crc(r);
+  bool ok = jrn_write(r);
+  g_jrn.flush();   // 意图必须先于数据落盘
+  g_io_us += micros() - t0;
+  if(type == JRN_INTENT) g_jrn_last = r;
+  else if(ok) jrn_resolve(path);
+  return ok;
+#else
+  (void)type; (void)path; (void)len;
+  return false;
+#endif
+}
+
+static inline uint8_t hist_bucket(uint32_t us){
+  uint8_t k = us ? (uint8_t)(31 - __builtin_clz(us)) : 0;
+  return k < ASYNC_SD_HIST_BUCKETS ? k : ASYNC_SD_HIST_BUCKETS - 1;
+}
+
+static void note_written(size_t w){
+  g_bytes += w;
+  uint32_t sec = millis() / 1000;
+  uint32_t i = sec % ASYNC_SD_RATE_WINDOW_S;
+  if(g_rate_sec[i] != sec){ g_rate_sec[i] = sec; g_rate_bytes[i] = 0; }
+  g_rate_bytes[i] += (uint32_t)w;
+}
+
+static bool wc_drain(){
+  if(!g_wc_len) return true;
+  uint32_t t0 = micros();
+  size_t w = g_cur.write(g_wc, g_wc_len);
+  g_io_us += micros() - t0;
+  bool ok = (w == g_wc_len);
+  if(ok) note_written(w);
+  g_wc_len = 0;
+  return ok;
+}
+
+// 结束当前文件：写出合并缓冲的尾部，flush 一次后关闭
+static void file_close(){
+  if(!g_cur_path[0]) return;
+  bool opened = (bool)g_cur;
+  if(g_cur){
+    if(!wc_drain()) g_cur_ok = false;
+    uint32_t t0 = micros();
+    g_cur.flush();
+    g_cur.close();
+    g_io_us += micros() - t0;
+  }
+  if(g_cur_intent){
+    // 未等到最后一块就被关闭（提交方中途放弃或掉卡）：不记提交；从未打开的文件不算遗留
+    if(opened) jrn_orphan();
+    g_cur_intent = false;
+  }
+  if(g_cur_whole){
+    uint32_t lat = millis() - g_cur_t0_ms;
+    g_file_lat_last = lat;
+    if(lat > g_file_lat_max) g_file_lat_max = lat;
+    g_files++;
+  }
+  g_cur_path[0] = '\0';
+}
+
+static bool file_open(const char* path, const char* mode, bool whole){
+  file_close();
+  uint32_t t0 = micros();
+  g_cur = SD.open(path, mode);
+  if(!g_cur && mode[0] == 'r') g_cur = SD.open(path, "w+");   // 定位写的目标文件尚不存在：创建
+  if(!g_cur && mode[0] != 'r' && sd_mkdir_parents(path)) g_cur = SD.open(path, mode);   // 分目录首次写入：建目录
+  if(!g_cur && mode[0] == 'r' && sd_mkdir_parents(path)) g_cur = SD.open(path, "w+");
+  g_io_us += micros() - t0;
+  strncpy(g_cur_path, path, ASYNC_SD_MAX_PATH-1);
+  g_cur_path[ASYNC_SD_MAX_PATH-1] = '\0';
+  g_cur_ok = (bool)g_cur;
+  g_cur_whole = whole;
+  g_cur_t0_ms = millis();
+  g_wc_len = 0;
+  return g_cur_ok;
+}
+
+// 同一路径的连续块复用文件句柄。
+// 整文件写首块以截断方式打开（FILE_WRITE 即 "w"，无需先 remove）；
+// 定位/追加写以 "r+" 打开（不存在则创建）并保留句柄，后续同路径的定位写只需 seek
+static bool file_open_for(const PoolBlk* b){
+  bool same = g_cur_path[0] && g_cur && strcmp(g_cur_path, b->path) == 0;
+  // 续写块只能接在本任务打开的句柄上：句柄已丢（首块打开失败、掉卡、空闲关闭）就不知道该写到哪，
+  // 重开接到末尾会把定位写的余下部分追加到段尾、或造出没有头部也没有写日志意图的文件
+  if(!b->is_first) return same;
+  if(b->offset == SD_ASYNC_OFF_TRUNC){
+    file_close();
+    jrn_append(JRN_INTENT, b->path, b->total);
+    if(!file_open(b->path, FILE_WRITE, true)) return false;
+    g_cur_intent = true;
+    return true;
+  }
+  if(!same && !file_open(b->path, "r+", false)) return false;
+  if(!wc_drain()) g_cur_ok = false;
+  if(b->offset == SD_ASYNC_OFF_APPEND) return g_cur.seek(0, SeekEnd);
+  return g_cur.seek(b->offset, SeekSet);
+}
+
+// 按 ASYNC_SD_WC_SIZE 合并写：文件偏移始终是合并块的整数倍，写入落在扇区边界上
+static bool write_combined(const uint8_t* data, size_t len){
+  bool ok = true;
+  while(len){
+    if(g_wc_len == 0 && len >= ASYNC_SD_WC_SIZE){
+      // 对齐且足够大：直接整块写，省一次拷贝
+      size_t n = len - (len % ASYNC_SD_WC_SIZE);
+      uint32_t t0 = micros();
+      size_t w = g_cur.write(data, n);
+      g_io_us += micros() - t0;
+      if(w != n) ok = false; else note_written(w);
+      data += n; len -= n;
+      continue;
+    }
+    size_t n = ASYNC_SD_WC_SIZE - g_wc_len;
+    if(n > len) n = len;
+    memcpy(g_wc + g_wc_len, data, n);
+    g_wc_len += n; data += n; len -= n;
+    if(g_wc_len == ASYNC_SD_WC_SIZE && !wc_drain()) ok = false;
+  }
+  return ok;
+}
+
+static bool write_chunk(const PoolBlk* b){
+  // 任务首块打开失败或中途丢了句柄，余下的块直到末块都丢弃（同 g_skip）
+  bool& broken = g_broken[b->prio];
+  if(b->is_first) broken = false;
+  if(broken){
+    if(b->is_last) broken = false;
+    return false;
+  }
+  if(!g_sd_ready){ file_close(); broken = !b->is_last; return false; }
+  if(!file_open_for(b)) {
+    if(b->is_last) file_close();
+    broken = !b->is_last;
+    return false;
+  }
+  bool ok = write_combined(b->data, b->len);
+  if(!ok) g_cur_ok = false;
+  g_cur_last_ms = millis();
+  if(b->is_last){
+    ok = ok && g_cur_ok;
+    if(g_cur_whole){
+      bool intent = g_cur_intent;
+      g_cur_intent = false;
+      file_close();
+      ok = ok && g_cur_ok;   // 关闭时写出的尾部也要成功
+      if(intent){
+        if(ok) jrn_append(JRN_COMMIT, b->path, b->total);
+        else jrn_orphan();
+      }
+    }else{
+      // 定位写：落盘但保留句柄，同一段文件的下一次写省去打开
+      if(!wc_drain()) ok = false;
+      g_cur.flush();
+      g_cur_ok = true;
+    }
+  }
+  return ok;
+}
+
+// 写任务执行一个读请求：同路径正在写则先把合并缓冲落盘，保证读到已提交的数据
+static void do_read(PoolBlk* b){
+  b->status = SD_ASYNC_RD_ERR;
+  size_t want = b->len;
+  b->len = 0;
+  if(g_sd_ready){
+    if(g_cur && g_cur_path[0] && strcmp(g_cur_path, b->path) == 0){
+      if(!wc_drain()) g_cur_ok = false;
+      g_cur.flush();
+    }
+    uint32_t t0 = micros();
+    if(!g_rd || strcmp(g_rd_path, b->path) != 0){
+      if(g_rd) g_rd.close();
+      g_rd = SD.open(b->path, FILE_READ);
+      strncpy(g_rd_path, b->path, ASYNC_SD_MAX_PATH-1);
+      g_rd_path[ASYNC_SD_MAX_PATH-1] = '\0';
+    }
+    if(g_rd){
+      b->total = g_rd.size();
+      if(g_rd.position() == b->offset || g_rd.seek(b->offset)){
+        b->len = g_rd.read(b->data, want);
+        b->status = (b->offset + b->len >= b->total) ? SD_ASYNC_RD_EOF : SD_ASYNC_RD_OK;
+        g_rd_bytes += b->len;
+      }
+    }else{
+      g_rd_path[0] = '\0';
+    }
+    g_io_us += micros() - t0;
+    g_rd_last_ms = millis();
+  }
+  g_rd_ops++;
+  ring_push(g_rd_done, b);   // 容量 >= 总块数，不会满
+}
+
+// 主循环用完的读块放回空闲环（空闲环只由写任务生产）
+static void rd_reclaim(){
+  PoolBlk* b;
+  while((b = ring_pop(g_rd_ret)) != nullptr) pool_give(b);
+}
+
+// 写任务取下一块：正在续写的多块任务必须先续完，后续块还没入队就等（别的路径会顶掉句柄，续写块无处可接）；
+// 等满 ASYNC_SD_IDLE_CLOSE_MS 视为提交方放弃，迟到的块丢弃。否则事件环先于普通环
+static PoolBlk* job_pop(){
+  PoolBlk* b = nullptr;
+  if(g_cont_prio >= 0){
+    b = ring_pop(g_jobs[g_cont_prio]);
+    if(b || millis() - g_cur_last_ms <= ASYNC_SD_IDLE_CLOSE_MS) return b;
+    g_broken[g_cont_prio] = true;
+    g_cont_prio = -1;
+  }
+  for(int p=0;p<SD_ASYNC_PRIO_COUNT && !b;p++) b = ring_pop(g_jobs[p]);
+  return b;
+}
+
+// 首块开写时已过期则整个任务（到末块为止）丢弃，不写半截
+static bool job_expired(const PoolBlk* b){
+  bool& skip = g_skip[b->prio];
+  if(b->is_first){
+    skip = b->deadline && (int32_t)(millis() - b->deadline) > 0;
+    if(skip) g_deadline_drop++;
+  }
+  bool drop = skip;
+  if(b->is_last) skip = false;
+  return drop;
+}
+
+static void writer_task(void*){
+  while(g_running){
+    g_writer_busy = true;   // 先置忙再取，避免 sd_async_idle 在出队与开写之间误判空闲
+    rd_reclaim();
+    PoolBlk* b = job_pop();
+    if(!b){
+      // 提交方中途放弃（未送达最后一块）：空闲超时后关闭，避免句柄长期占用
+      if(g_cur_path[0] && millis() - g_cur_last_ms > ASYNC_SD_IDLE_CLOSE_MS) file_close();
+      if(g_rd && millis() - g_rd_last_ms > ASYNC_SD_IDLE_CLOSE_MS){ g_rd.close(); g_rd_path[0] = '\0'; }
+      g_writer_busy = false;
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+      continue;
+    }
+    if(b->op == BLK_OP_READ){
+      do_read(b);   // 块随完成环交给主循环，由其用完后经归还环送回
+      g_writer_busy = false;
+      continue;
+    }
+    g_cont_prio = b->is_last ? -1 : b->prio;
+    if(!job_expired(b)){
+      uint32_t t_start = micros();
+      bool ok = write_chunk(b);
+      uint32_t t_end = micros();
+      if(ok) g_wr_ok++; else g_wr_fail++;
+      if(!ok) g_job_fail = true;
+      if(b->is_last){
+        g_wr_fail_run = g_job_fail ? g_wr_fail_run + 1 : 0;
+        g_job_fail = false;
+      }
+      uint32_t wait = t_start - b->enq_us, wr = t_end - t_start, lat = t_end - b->enq_us;
+      g_wait_hist[hist_bucket(wait)]++;
+      g_write_hist[hist_bucket(wr)]++;
+      if(wait > g_wait_max_us) g_wait_max_us = wait;
+      if(wr > g_write_max_us) g_write_max_us = wr;
+      if(lat > g_lat_max_us) g_lat_max_us = lat;
+    }
+    pool_give(b);
+    g_writer_busy = false;
+  }
+  file_close();
+  if(g_jrn) g_jrn.close();
+  if(g_rd) g_rd.close();
+  g_task = nullptr;
+  vTaskDelete(nullptr);
+}
+
+bool sd_async_init(){
+  pool_init();
+  for(int p=0;p<SD_ASYNC_PRIO_COUNT;p++){
+    if(!g_jobs[p].slot) ring_init(g_jobs[p], g_pool_total ? g_pool_total : 1);
+  }
+  if(!g_rd_done.slot) ring_init(g_rd_done, g_pool_total ? g_pool_total : 1);
+  if(!g_rd_ret.slot) ring_init(g_rd_ret, g_pool_total ? g_pool_total : 1);
+  if(!g_space) g_space = xSemaphoreCreateBinary();
+  if(!g_wc){
+    // 合并缓冲优先放内部RAM（SPI DMA 可直接用）
+    g_wc = (uint8_t*)heap_caps_malloc(ASYNC_SD_WC_SIZE, MALLOC_CAP_DMA | MALLOC_CAP_8BIT);
+    if(!g_wc) g_wc = (uint8_t*)heap_caps_malloc(ASYNC_SD_WC_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  }
+  return (g_jobs[SD_ASYNC_PRIO_EVENT].slot && g_jobs[SD_ASYNC_PRIO_BULK].slot &&
+          g_rd_done.slot && g_rd_ret.slot && g_space && g_wc && g_pool_total>0);
+}
+
+bool sd_async_start(){
+  if(g_task) return true;
+  g_running = true;
+  BaseType_t rc = xTaskCreatePinnedToCore(writer_task, "sdw",
+                                          ASYNC_SD_TASK_STACK, nullptr,
+                                          ASYNC_SD_TASK_PRIO, &g_task,
+                                          tskNO_AFFINITY);
+  return rc == pdPASS;
+}
+
+void sd_async_stop(bool drain){
+  if(!g_task) return;
+  if(drain) sd_async_flush(ASYNC_SD_FLUSH_TIMEOUT_MS);
+  g_running = false;
+  TaskHandle_t t = g_task;
+  if(t) xTaskNotifyGive(t);
+  uint32_t t0 = millis();
+  while(g_task && millis() - t0 < 200) vTaskDelay(pdMS_TO_TICKS(10));
+  g_task = nullptr;
+}
+
+bool sd_async_on_sd_ready(){
+  g_sd_ready = true;
+  return true;
+}
+
+void sd_async_on_sd_lost(){
+  g_sd_ready = false;
+}
+
+// 准入：整个提交放得下才开始取块，不会出现只入队了前几块的半截文件。
+// 放不下时挂在 g_space 上等写任务归还块，最多等到 wait_ms 或截止时刻
+static SdAsyncPressure admit(size_t len, const SdAsyncAdmit& adm){
+  if(!admit_fits(len, adm.prio)){
+    uint32_t wait = adm.wait_ms;
+    if(adm.deadline_ms && adm.deadline_ms < wait) wait = adm.deadline_ms;
+    uint32_t t0 = millis();
+    for(;;){
+      uint32_t el = millis() - t0;
+      if(el >= wait || !g_task){
+        g_space_wait = false;
+        g_bp_full++;
+        return SD_ASYNC_BP_FULL;
+      }
+      g_space_wait = true;
+      if(admit_fits(len, adm.prio)) break;   // 置标志后再查一次，防止错过唤醒
+      xSemaphoreTake(g_space, pdMS_TO_TICKS(wait - el));
+      if(admit_fits(len, adm.prio)) break;
+    }
+    g_space_wait = false;
+    uint32_t el = millis() - t0;
+    if(el > g_wait_ms_max) g_wait_ms_max = el;
+  }
+  SdAsyncPressure bp = pressure_after(len);
+  if(bp == SD_ASYNC_BP_HIGH) g_bp_high++;
+  return bp;
+}
+
+// 仅主循环调用（任务环与空闲环的单生产者/单消费者约定）
+static bool submit_impl(const char* path, uint32_t where, const uint8_t* data, size_t len,
+                        const SdAsyncAdmit& adm, SdAsyncPressure* bp_out){
+  SdAsyncPressure bp = SD_ASYNC_BP_FULL;
+  bool ok = false;
+  if(path && data && len && g_jobs[SD_ASYNC_PRIO_EVENT].slot && g_pool_total && adm.prio < SD_ASYNC_PRIO_COUNT){
+    uint32_t t_sub = millis();
+    bp = admit(len, adm);
+    ok = (bp != SD_ASYNC_BP_FULL);
+    size_t remain = ok ? len : 0;
+    size_t offset = 0;
+    bool   first  = true;
+    while(remain){
+      PoolBlk* b = pool_take(remain);
+      if(!b){ ok = false; break; }   // 准入已保证放得下，不应发生
+      size_t chunk = remain;
+      if(chunk > b->cap) chunk = b->cap;
+      memcpy(b->data, data + offset, chunk);
+      b->len = chunk;
+      strncpy(b->path, path, ASYNC_SD_MAX_PATH-1);
+      b->path[ASYNC_SD_MAX_PATH-1] = '\0';
+      b->is_first = first;
+      b->is_last = (remain == chunk);
+      b->offset = where;
+      b->total = (uint32_t)len;
+      b->prio = adm.prio;
+      b->op = BLK_OP_WRITE;
+      b->deadline = adm.deadline_ms ? (t_sub + adm.deadline_ms) | 1 : 0;   // |1：避免恰好算出0
+      first = false;
+
+      q_send(b);   // 任务环容量 >= 总块数，不会失败
+
+      offset += chunk;
+      remain -= chunk;
+    }
+  }
+  if(bp_out) *bp_out = bp;
+  return ok;
+}
+
+static bool submit_timed(const char* path, uint32_t offset, const uint8_t* data, size_t len,
+                         const SdAsyncAdmit& adm, SdAsyncPressure* bp){
+  uint32_t t0 = micros();
+  bool ok = submit_impl(path, offset, data, len, adm, bp);
+  uint32_t us = micros() - t0;
+  g_sub_last_us = us;
+  if(us > g_sub_max_us) g_sub_max_us = us;
+  g_sub_sum_us += us;
+  g_sub_n++;
+  return ok;
+}
+
+static SdAsyncAdmit bulk_admit(uint32_t timeout_ms){
+  SdAsyncAdmit adm;
+  adm.prio = SD_ASYNC_PRIO_BULK;
+  adm.wait_ms = timeout_ms;
+  return adm;
+}
+
+bool sd_async_submit(const char* path, const uint8_t* data, size_t len, uint32_t timeout_ms){
+  return submit_timed(path, SD_ASYNC_OFF_TRUNC, data, len, bulk_admit(timeout_ms), nullptr);
+}
+
+bool sd_async_submit_at(const char* path, uint32_t offset, const uint8_t* data, size_t len, uint32_t timeout_ms){
+  return submit_timed(path, offset, data, len, bulk_admit(timeout_ms), nullptr);
+}
+
+bool sd_async_submit_ex(const char* path, uint32_t offset, const uint8_t* data, size_t len,
+                        const SdAsyncAdmit& adm, SdAsyncPressure* bp){
+  return submit_timed(path, offset, data, len, adm, bp);
+}
+
+SdAsyncPressure sd_async_pressure(size_t len, uint8_t prio){
+  if(!g_pool_total || !admit_fits(len, prio)) return SD_ASYNC_BP_FULL;
+  return pressure_after(len);
+}
+
+static bool grp_commit(AppendGroup& g, uint32_t wait_ms){
+  if(!g.len) return true;
+  SdAsyncAdmit adm;
+  adm.prio = SD_ASYNC_PRIO_BULK;
+  adm.wait_ms = wait_ms;
+  if(!submit_timed(g.path, SD_ASYNC_OFF_APPEND, g.buf, g.len, adm, nullptr)) return false;
+  g.len = 0;
+  g_grp_commits++;
+  return true;
+}
+
+// 找 path 的合并槽；没有则取空槽，槽都在用时提交并让出最久未用的一个
+static AppendGroup* grp_for(const char* path){
+  AppendGroup* victim = nullptr;
+  for(int i=0;i<ASYNC_SD_GROUP_SLOTS;i++){
+    AppendGroup& g = g_grp[i];
+    if(g.path[0] && strcmp(g.path, path) == 0) return &g;
+    if(!victim || (victim->path[0] && (!g.path[0] || (int32_t)(g.used_ms - victim->used_ms) < 0))) victim = &g;
+  }
+  if(!grp_commit(*victim, 0)) return nullptr;
+  strncpy(victim->path, path, ASYNC_SD_MAX_PATH-1);
+  victim->path[ASYNC_SD_MAX_PATH-1] = '\0';
+  return victim;
+}
+
+bool sd_async_append(const char* path, const void* rec, size_t len, uint8_t durability){
+  if(!path || !rec || !len || !g_pool_total) return false;
+  if(!g_grp_mem){
+    g_grp_mem = (uint8_t*)heap_caps_malloc(ASYNC_SD_GROUP_SLOTS * ASYNC_SD_GROUP_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if(!g_grp_mem) return false;
+    for(int i=0;i<ASYNC_SD_GROUP_SLOTS;i++) g_grp[i].buf = g_grp_mem + (size_t)i * ASYNC_SD_GROUP_BYTES;
+  }
+  AppendGroup* g = grp_for(path);
+  if(!g) return false;
+  uint32_t now = millis();
+  g->used_ms = now;
+  // 放不下先把已攒的写出去，保证追加顺序
+  if(g->len + len > ASYNC_SD_GROUP_BYTES && !grp_commit(*g, ASYNC_SD_SUBMIT_TIMEOUT_MS)) return false;
+  bool ok = true;
+  if(len > ASYNC_SD_GROUP_BYTES){
+    SdAsyncAdmit adm;
+    adm.prio = SD_ASYNC_PRIO_BULK;
+    adm.wait_ms = ASYNC_SD_SUBMIT_TIMEOUT_MS;
+    if(!submit_timed(path, SD_ASYNC_OFF_APPEND, (const uint8_t*)rec, len, adm, nullptr)) return false;
+    g_grp_commits++;
+  }else{
+    if(!g->len) g->first_ms = now;
+    memcpy(g->buf + g->len, rec, len);
+    g->len += len;
+    if(durability != SD_ASYNC_DUR_BUFFERED || g->len >= ASYNC_SD_GROUP_BYTES){
+      // 缓冲攒满时提交失败不算错：记录仍在内存里，下次追加或超时再写
+      bool c = grp_commit(*g, ASYNC_SD_SUBMIT_TIMEOUT_MS);
+      if(durability != SD_ASYNC_DUR_BUFFERED) ok = c;
+    }
+  }
+  g_grp_records++;
+  if(ok && durability == SD_ASYNC_DUR_SYNC) ok = sd_async_flush(ASYNC_SD_FLUSH_TIMEOUT_MS);
+  return ok;
+}
+
+bool sd_async_append_flush(const char* path){
+  bool ok = true;
+  for(int i=0;i<ASYNC_SD_GROUP_SLOTS;i++){
+    AppendGroup& g = g_grp[i];
+    if(!g.len || (path && strcmp(g.path, path) != 0)) continue;
+    if(!grp_commit(g, ASYNC_SD_SUBMIT_TIMEOUT_MS)) ok = false;
+  }
+  return ok;
+}
+
+// 超时的合并组提交（不等待，放不下下轮再试）
+static void grp_drive(){
+  uint32_t now = millis();
+  for(int i=0;i<ASYNC_SD_GROUP_SLOTS;i++){
+    AppendGroup& g = g_grp[i];
+    if(g.len && now - g.first_ms >= ASYNC_SD_GROUP_MAX_MS) grp_commit(g, 0);
+  }
+}
+
+// 为读流请求下一块（低优先级环，须给事件照片留出预留空间）
+static bool rd_issue(int id){
+  ReadStream& rs = g_rs[id];
+  if(rs.next >= rs.end) return false;
+  size_t want = rs.end - rs.next;
+  if(want > ASYNC_SD_READ_CHUNK) want = ASYNC_SD_READ_CHUNK;
+  if(!admit_fits(want, SD_ASYNC_PRIO_BULK)) return false;
+  PoolBlk* b = pool_take(want);
+  if(!b) return false;
+  if(want > b->cap) want = b->cap;
+  b->op = BLK_OP_READ;
+  b->stream = (uint8_t)id;
+  b->len = want;
+  b->offset = rs.next;
+  b->total = 0;
+  b->is_first = b->is_last = true;
+  b->prio = SD_ASYNC_PRIO_BULK;
+  b->deadline = 0;
+  strncpy(b->path, rs.path, ASYNC_SD_MAX_PATH-1);
+  b->path[ASYNC_SD_MAX_PATH-1] = '\0';
+  q_send(b);
+  rs.next += want;
+  rs.inflight++;
+  return true;
+}
+
+int sd_async_read(const char* path, uint32_t offset, SdAsyncReadCb cb, void* ctx, uint32_t max_bytes){
+  if(!path || !cb || !g_task || !g_rd_done.slot) return -1;
+  for(int id=0;id<ASYNC_SD_READ_STREAMS;id++){
+    ReadStream& rs = g_rs[id];
+    if(rs.active) continue;
+    rs.active = true;
+    rs.finished = false;
+    rs.inflight = 0;
+    rs.next = offset;
+    rs.end = max_bytes ? offset + max_bytes : 0xFFFFFFFFu;
+    rs.cb = cb;
+    rs.ctx = ctx;
+    strncpy(rs.path, path, ASYNC_SD_MAX_PATH-1);
+    rs.path[ASYNC_SD_MAX_PATH-1] = '\0';
+    rd_issue(id);   // 池暂时没空间时由 sd_async_poll 补发
+    return id;
+  }
+  return -1;
+}
+
+void sd_async_read_cancel(int id){
+  if(id < 0 || id >= ASYNC_SD_READ_STREAMS || !g_rs[id].active) return;
+  ReadStream& rs = g_rs[id];
+  rs.finished = true;
+  if(rs.inflight == 0) rs.active = false;
+}
+
+// 主循环调用：按序交付读完成的块并回调，用完的块送回写任务；再为未读完的流补足预读；
+// 最后提交超时的追加合并组
+uint32_t sd_async_poll(){
+  if(!g_rd_done.slot) return 0;
+  grp_drive();
+  // 运行中隔离的半截文件
+  uint32_t qt = g_qr_tail.load(std::memory_order_relaxed);
+  while(qt != g_qr_head.load(std::memory_order_acquire)){
+    if(g_on_partial) g_on_partial(g_qr_path[qt % ASYNC_SD_JOURNAL_ORPHANS]);
+    g_qr_tail.store(++qt, std::memory_order_release);
+  }
+  uint32_t n = 0;
+  PoolBlk* b;
+  while((b = ring_pop(g_rd_done)) != nullptr){
+    ReadStream& rs = g_rs[b->stream];
+    if(rs.inflight) rs.inflight--;
+    if(rs.active && !rs.finished){
+      int st = b->status;
+      if(st == SD_ASYNC_RD_OK && b->offset + b->len >= rs.end) st = SD_ASYNC_RD_EOF;
+      if(st != SD_ASYNC_RD_OK) rs.finished = true;   // 先置位，回调里可以另起新流
+      rs.cb(rs.ctx, b->data, b->len, b->offset, b->total, st);
+    }
+    if(rs.finished && rs.inflight == 0) rs.active = false;
+    ring_push(g_rd_ret, b);
+    n++;
+  }
+  if(n && g_task) xTaskNotifyGive(g_task);
+  for(int id=0;id<ASYNC_SD_READ_STREAMS;id++){
+    ReadStream& rs = g_rs[id];
+    if(!rs.active || rs.finished) continue;
+    while(rs.inflight < ASYNC_SD_READ_AHEAD && rd_issue(id)) {}
+  }
+  return n;
+}
+
+bool sd_async_flush(uint32_t timeout_ms){
+  uint32_t t0 = millis();
+  while(!sd_async_idle() && (millis() - t0 < timeout_ms)){
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+  return sd_async_idle();
+}
+
+// 只读计数，不碰提交/写入路径
+void sd_async_get_stats(SdAsyncStats& out){
+  out.enq_ok = g_enq_ok;
+  out.enq_drop = g_enq_drop;
+  out.write_ok = g_wr_ok;
+  out.write_fail = g_wr_fail;
+  out.write_fail_run = g_wr_fail_run;
+  out.pool_total = g_pool_total;
+  out.pool_free = pool_free_count();
+  for(int c=0;c<SLAB_CLASSES;c++){
+    out.slab_size[c] = SLAB_SIZE[c];
+    out.slab_total[c] = g_slab[c].total;
+    out.slab_used[c] = g_slab[c].total - ring_count(g_slab[c].free);
+    out.slab_hw[c] = g_slab[c].hw;
+    out.slab_miss[c] = g_slab[c].miss;
+  }
+  out.q_depth = jobs_count();
+  out.q_max = g_q_max;
+  out.running = g_running;
+  out.sd_ready = g_sd_ready;
+  out.task_stack_min = g_task ? uxTaskGetStackHighWaterMark(g_task) : 0;
+  out.bytes_written = g_bytes;
+  out.files_closed = g_files;
+  uint64_t io_us = g_io_us;
+  out.write_kbps = io_us ? (uint32_t)(g_bytes * 1000ULL / io_us) : 0;  // 字节/微秒*1000 = KB/s
+  out.file_lat_last_ms = g_file_lat_last;
+  out.file_lat_max_ms = g_file_lat_max;
+  out.bench_kbps = g_bench_kbps;
+  out.submit_us_last = g_sub_last_us;
+  out.submit_us_max = g_sub_max_us;
+  out.submit_us_avg = g_sub_n ? (uint32_t)(g_sub_sum_us / g_sub_n) : 0;
+  out.journal_partial = g_jrn_partial;
+  out.journal_orphans = g_jrn_orphans;
+  out.bp_high = g_bp_high;
+  out.bp_full = g_bp_full;
+  out.admit_wait_ms_max = g_wait_ms_max;
+  out.deadline_drop = g_deadline_drop;
+  for(int k=0;k<ASYNC_SD_HIST_BUCKETS;k++){
+    out.wait_hist[k] = g_wait_hist[k];
+    out.write_hist[k] = g_write_hist[k];
+  }
+  out.wait_max_us = g_wait_max_us;
+  out.write_max_us = g_write_max_us;
+  out.lat_max_us = g_lat_max_us;
+  uint32_t now = millis() / 1000, sum = 0;
+  for(int i=0;i<ASYNC_SD_RATE_WINDOW_S;i++){
+    // 只算已结束的整秒，当前这一秒还没写完
+    if(now - g_rate_sec[i] >= 1 && now - g_rate_sec[i] <= ASYNC_SD_RATE_WINDOW_S) sum += g_rate_bytes[i];
+  }
+  out.rate_bps = sum / ASYNC_SD_RATE_WINDOW_S;
+  out.read_ops = g_rd_ops;
+  out.bytes_read = g_rd_bytes;
+  out.append_records = g_grp_records;
+  out.append_commits = g_grp_commits;
+}
+
+// 直方图第 pct 百分位所在桶的上界（微秒），无样本返回0
+uint32_t sd_async_hist_percentile(const uint32_t* hist, uint8_t pct){
+  uint64_t n = 0;
+  for(int k=0;k<ASYNC_SD_HIST_BUCKETS;k++) n += hist[k];
+  if(!n) return 0;
+  uint64_t want = (n * pct + 99) / 100, acc = 0;
+  for(int k=0;k<ASYNC_SD_HIST_BUCKETS;k++){
+    acc += hist[k];
+    if(acc >= want) return (k >= 31) ? 0xFFFFFFFFu : ((2u << k) - 1);
+  }
+  return 0xFFFFFFFFu;
+}
+
+// 开机恢复：顺序读日志，提交记录对应写任务当时的最新意图。未提交的意图按路径留待检查，
+// 同一路径后来又写（意图更新）的只查最后一次；表满时先查最旧的一条。
+// 耗时只与日志长度有关；日志尾部撕裂（CRC错）的记录视为结束
+uint32_t sd_async_recover(void (*on_partial)(const char*)){
+#if ASYNC_SD_JOURNAL_ENABLE
+  if(g_task || !g_sd_ready) return 0;   // 只在写任务启动前调用
+  g_on_partial = on_partial;            // 运行中隔离的半截文件也经它通知
+  File f = SD.open(ASYNC_SD_JOURNAL_PATH, FILE_READ);
+  if(!f) return 0;
+  static JrnRec pend[ASYNC_SD_JOURNAL_ORPHANS + 1];
+  uint8_t np = 0;
+  uint32_t n = 0;
+  JrnRec r;
+  while(f.read((uint8_t*)&r, sizeof(r)) == sizeof(r)){
+    if(r.crc != jrn_crc(r)) break;
+    r.path[ASYNC_SD_MAX_PATH-1] = '\0';
+    if(r.type == JRN_INTENT){
+      for(uint8_t i=0;i<np;){
+        if(strcmp(pend[i].path, r.path) == 0){ memmove(&pend[i], &pend[i+1], (np - i - 1) * sizeof(JrnRec)); np--; }
+        else i++;
+      }
+      if(np == ASYNC_SD_JOURNAL_ORPHANS + 1){
+        if(jrn_check(pend[0], on_partial)) n++;
+        memmove(&pend[0], &pend[1], (np - 1) * sizeof(JrnRec));
+        np--;
+      }
+      pend[np++] = r;
+    }else if(r.type == JRN_COMMIT && np && pend[np-1].seq == r.seq){
+      np--;
+    }
+  }
+  f.close();
+  for(uint8_t i=0;i<np;i++) if(jrn_check(pend[i], on_partial)) n++;
+  SD.remove(ASYNC_SD_JOURNAL_PATH);
+  g_jrn_partial = n;
+  return n;
+#else
+  (void)on_partial;
+  return 0;
+#endif
+}
+
+// 基准测试：经由任务环写一个测试文件，端到端计时（含排队、合并写与关闭）后删除
+uint32_t sd_async_benchmark(size_t bytes){
+  if(!g_jobs[SD_ASYNC_PRIO_BULK].slot || !g_pool_total || !g_sd_ready || bytes == 0) return 0;
+  if(!sd_async_flush(ASYNC_SD_FLUSH_TIMEOUT_MS)) return 0;
+  const size_t PAT = 4096;
+  uint8_t* pat = (uint8_t*)heap_caps_malloc(PAT, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if(!pat) pat = (uint8_t*)malloc(PAT);
+  if(!pat) return 0;
+  for(size_t i=0;i<PAT;i++) pat[i] = (uint8_t)i;
+
+  static const char* BENCH_PATH = "/sdbench.bin";
+  uint32_t t0 = millis();
+  bool ok = true;
+  size_t off = 0;
+  while(off < bytes){
+    size_t n = bytes - off;
+    if(n > PAT) n = PAT;
+    PoolBlk* b = pool_take(n);
+    while(!b && millis() - t0 < ASYNC_SD_FLUSH_TIMEOUT_MS){ vTaskDelay(pdMS_TO_TICKS(2)); b = pool_take(n); }
+    if(!b){ ok = false; break; }
+    memcpy(b->data, pat, n);
+    b->len = n;
+    strncpy(b->path, BENCH_PATH, ASYNC_SD_MAX_PATH-1);
+    b->path[ASYNC_SD_MAX_PATH-1] = '\0';
+    b->is_first = (off == 0);
+    b->is_last = (off + n == bytes);
+    b->offset = SD_ASYNC_OFF_TRUNC;
+    b->total = (uint32_t)bytes;
+    b->prio = SD_ASYNC_PRIO_BULK;
+    b->op = BLK_OP_WRITE;
+    b->deadline = 0;
+    q_send(b);
+    off += n;
+  }
+  free(pat);
+  ok = sd_async_flush(ASYNC_SD_FLUSH_TIMEOUT_MS) && ok;
+  uint32_t ms = millis() - t0;
+  SD.remove(BENCH_PATH);
+  if(!ok || ms == 0) return 0;
+  g_bench_kbps = (uint32_t)((uint64_t)bytes / ms);  // 字节/毫秒 ≈ KB/s
+  return g_bench_kbps;
+}
+
+bool sd_async_idle(){
+  return (jobs_count() == 0 && !g_writer_busy);
+}
+
 #endif
\ No newline at end of file
@@ -1,37 +1,153 @@
-#pragma once
-#include <Arduino.h>
-#include "config.h"  
-
-struct SdAsyncStats {
-  uint32_t enq_ok = 0;
-  uint32_t enq_drop = 0;
-  uint32_t write_ok = 0;
-  uint32_t write_fail = 0;
-  uint32_t pool_free = 0;
-  uint32_t pool_total = 0;
-  uint32_t q_depth = 0;
-  uint32_t q_max = 0;
-  uint32_t task_stack_min = 0; // 最小剩余栈
-  bool     running = false;
-  bool     sd_ready = false;
-};
-
-// 后台异步SD写接口（采用 FreeRTOS 任务+内存池）
-bool sd_async_init();                      // 仅初始化数据结构（不启任务）
-bool sd_async_start();                     // 启动后台写任务
-void sd_async_stop(bool drain = true);     // 停止任务；drain=true会试着写完队列
-bool sd_async_on_sd_ready();               // SD挂载完成后调用（或在 start 之前已挂载）
-void sd_async_on_sd_lost();                // SD拔出/重挂前调用
-
-// 提交一个写任务（内部会处理大于池块的缓冲：按块切分并按顺序追加写）
-bool sd_async_submit(const char* path, const uint8_t* data, size_t len,
-                     uint32_t timeout_ms = ASYNC_SD_SUBMIT_TIMEOUT_MS);
-
-// 等待队列清空
-bool sd_async_flush(uint32_t timeout_ms = ASYNC_SD_FLUSH_TIMEOUT_MS);
-
-// 获取运行统计
-void sd_async_get_stats(SdAsyncStats& out);
-
-// 是否空闲（队列空且任务无在写）
-bool sd_async_idle();
\ No newline at end of file
+#pragma once
+#include <Arduino.h>
+#include "config.h"  
+
+struct SdAsyncStats {
+  uint32_t enq_ok = 0;
+  uint32_t enq_drop = 0;
+  uint32_t write_ok = 0;
+  uint32_t write_fail = 0;
+  uint32_t write_fail_run = 0;   // 连续写失败的任务数（成功一次清零）
+  uint32_t pool_free = 0;
+  uint32_t pool_total = 0;
+  // 尺寸类（小/中/大）
+  uint32_t slab_size[3] = {0};
+  uint32_t slab_total[3] = {0};
+  uint32_t slab_used[3] = {0};
+  uint32_t slab_hw[3] = {0};      // 同时在用的最大块数
+  uint32_t slab_miss[3] = {0};    // 本类无空闲的次数
+  uint32_t q_depth = 0;
+  uint32_t q_max = 0;
+  uint32_t task_stack_min = 0; // 最小剩余栈
+  bool     running = false;
+  bool     sd_ready = false;
+  // 吞吐与延迟
+  uint64_t bytes_written = 0;
+  uint32_t files_closed = 0;
+  uint32_t write_kbps = 0;        // 按实际SD写耗时计算的吞吐（KB/s）
+  uint32_t file_lat_last_ms = 0;  // 单文件：首块开写到关闭
+  uint32_t file_lat_max_ms = 0;
+  uint32_t bench_kbps = 0;        // 最近一次 sd_async_benchmark 结果（端到端，KB/s）
+  // 提交耗时（sd_async_submit 整体，含取块与拷贝）
+  uint32_t submit_us_last = 0;
+  uint32_t submit_us_max = 0;
+  uint32_t submit_us_avg = 0;
+  // 写日志
+  uint32_t journal_partial = 0;   // 隔离的半截文件（开机恢复与运行中）
+  uint32_t journal_orphans = 0;   // 本次运行中未写完即关闭的整文件写
+  // 准入
+  uint32_t bp_high = 0;           // 入队后占用超过 ASYNC_SD_BP_HIGH_PCT 的次数
+  uint32_t bp_full = 0;           // 等到超时/截止仍放不下被拒的次数
+  uint32_t admit_wait_ms_max = 0; // 等空间的最长时间
+  uint32_t deadline_drop = 0;     // 开写时已过截止时刻被丢弃的任务数
+  // 每块延迟分布：第k桶计 [2^k, 2^(k+1)) 微秒（0 计入第0桶，末桶含更大值）
+  uint32_t wait_hist[ASYNC_SD_HIST_BUCKETS] = {0};    // 入队->开写
+  uint32_t write_hist[ASYNC_SD_HIST_BUCKETS] = {0};   // 开写->写完（含打开/合并写/关闭）
+  uint32_t wait_max_us = 0;
+  uint32_t write_max_us = 0;
+  uint32_t lat_max_us = 0;        // 入队->写完
+  uint32_t rate_bps = 0;          // 最近 ASYNC_SD_RATE_WINDOW_S 秒的平均写入字节/秒
+  // 异步读
+  uint32_t read_ops = 0;
+  uint64_t bytes_read = 0;
+  // 小记录合并
+  uint32_t append_records = 0;
+  uint32_t append_commits = 0;    // 实际入队的追加写次数
+};
+
+// 优先级：每级一个任务环，写任务先写事件环。同一路径的写须用同一优先级（跨环不保证顺序）
+enum SdAsyncPrio : uint8_t {
+  SD_ASYNC_PRIO_EVENT = 0,    // 事件照片（拍照路径）
+  SD_ASYNC_PRIO_BULK  = 1,    // 缩略图、目录、清单等后台写
+  SD_ASYNC_PRIO_COUNT
+};
+
+// 背压：OK=宽裕；HIGH=已入队但池占用偏高，调用方宜降画质/减少写入；FULL=未入队
+enum SdAsyncPressure : uint8_t {
+  SD_ASYNC_BP_OK = 0,
+  SD_ASYNC_BP_HIGH,
+  SD_ASYNC_BP_FULL
+};
+
+struct SdAsyncAdmit {
+  uint8_t  prio = SD_ASYNC_PRIO_BULK;
+  uint32_t wait_ms = 0;       // 放不下时最多等多久（写任务归还块即唤醒重试）
+  uint32_t deadline_ms = 0;   // 相对提交时刻：到时仍未开写则整个任务丢弃，0=不限
+};
+
+// 后台异步SD写接口（FreeRTOS 写任务 + 尺寸类内存池 + 无锁单生产者/单消费者环）
+// 提交类接口只允许主循环一个任务调用
+bool sd_async_init();                      // 仅初始化数据结构（不启任务）
+bool sd_async_start();                     // 启动后台写任务
+void sd_async_stop(bool drain = true);     // 停止任务；drain=true会试着写完队列
+bool sd_async_on_sd_ready();               // SD挂载完成后调用（或在 start 之前已挂载）
+void sd_async_on_sd_lost();                // SD拔出/重挂前调用
+
+// 提交一个写任务（内部会处理大于池块的缓冲：按块切分并按顺序追加写）。
+// sd_async_submit / sd_async_submit_at 为低优先级、最多等 timeout_ms
+bool sd_async_submit(const char* path, const uint8_t* data, size_t len,
+                     uint32_t timeout_ms = ASYNC_SD_SUBMIT_TIMEOUT_MS);
+
+// 定位写：从 offset 起覆盖写（文件不存在则创建），offset=SD_ASYNC_OFF_APPEND 时追加到末尾。
+// 写完只 flush 不关闭，同一文件的后续定位写复用句柄（空闲超时后关闭）
+#define SD_ASYNC_OFF_TRUNC  0xFFFFFFFFu   // sd_async_submit 使用：截断重写整个文件
+#define SD_ASYNC_OFF_APPEND 0xFFFFFFFEu
+bool sd_async_submit_at(const char* path, uint32_t offset, const uint8_t* data, size_t len,
+                        uint32_t timeout_ms = ASYNC_SD_SUBMIT_TIMEOUT_MS);
+
+// 带准入参数的提交：整体放得下才入队（不会只入队一部分），*bp 返回入队后的背压级别
+bool sd_async_submit_ex(const char* path, uint32_t offset, const uint8_t* data, size_t len,
+                        const SdAsyncAdmit& adm, SdAsyncPressure* bp = nullptr);
+
+// 不提交，只估算此刻提交 len 字节的背压级别（len=0 即当前占用）
+SdAsyncPressure sd_async_pressure(size_t len = 0, uint8_t prio = SD_ASYNC_PRIO_BULK);
+
+// 等待队列清空
+bool sd_async_flush(uint32_t timeout_ms = ASYNC_SD_FLUSH_TIMEOUT_MS);
+
+// 获取运行统计
+void sd_async_get_stats(SdAsyncStats& out);
+
+// 是否空闲（队列空且任务无在写）
+bool sd_async_idle();
+
+// 写入吞吐基准：经队列写 bytes 字节测试文件后删除，返回端到端 KB/s（失败返回0），结果同时记入统计
+uint32_t sd_async_benchmark(size_t bytes = 1024 * 1024);
+
+// 掉电恢复：按写日志找出上次未写完的整文件写，改名加 ASYNC_SD_QUARANTINE_SUFFIX 隔离，
+// 每个隔离的原路径回调一次 on_partial。须在 sd_async_start 之前、SD就绪后调用，返回隔离数。
+// 运行中遗留表满时写任务隔离的文件，也在 sd_async_poll 中经同一回调通知
+uint32_t sd_async_recover(void (*on_partial)(const char* path) = nullptr);
+
+// 由 wait_hist/write_hist 估算第 pct 百分位延迟（所在桶的上界，微秒）
+uint32_t sd_async_hist_percentile(const uint32_t* hist, uint8_t pct);
+
+// 异步读：由写任务执行（SPI总线只在一个任务里），与写入交错。
+// 从 offset 顺序读到文件末尾（或 max_bytes），按 ASYNC_SD_READ_CHUNK 分块、最多 ASYNC_SD_READ_AHEAD 块预读，
+// 每块按顺序回调一次；status 为 EOF/ERR 的是最后一次回调。回调在 sd_async_poll 中（主循环上下文）执行，
+// data 只在回调内有效
+#define SD_ASYNC_RD_OK   0
+#define SD_ASYNC_RD_EOF  1     // 本块是最后一块（len 可为0）
+#define SD_ASYNC_RD_ERR  (-1)  // 打开/定位失败
+typedef void (*SdAsyncReadCb)(void* ctx, const uint8_t* data, size_t len,
+                              uint32_t offset, uint32_t file_size, int status);
+
+// 返回读流号（失败返回-1：写任务未运行或读流已满）
+int sd_async_read(const char* path, uint32_t offset, SdAsyncReadCb cb, void* ctx, uint32_t max_bytes = 0);
+void sd_async_read_cancel(int id);   // 之后不再回调
+
+// 主循环调用：执行读完成回调并补发预读，返回本次交付的块数
+uint32_t sd_async_poll();
+
+// 小记录追加（日志、遥测、索引等）：同一路径的记录在内存中合并，攒满/超时/显式提交时一次追加写入。
+// 持久级别：BUFFERED=只进内存（最多丢 ASYNC_SD_GROUP_MAX_MS 内的记录）；
+// COMMIT=连同已攒记录立即入队；SYNC=入队并等写任务写完。
+// 仅主循环调用；返回 false 表示未达到要求的级别（BUFFERED 以外时记录仍在内存中，随后续提交写出）
+enum SdAsyncDurability : uint8_t {
+  SD_ASYNC_DUR_BUFFERED = 0,
+  SD_ASYNC_DUR_COMMIT,
+  SD_ASYNC_DUR_SYNC
+};
+bool sd_async_append(const char* path, const void* rec, size_t len,
+                     uint8_t durability = SD_ASYNC_DUR_BUFFERED);
+bool sd_async_append_flush(const char* path = nullptr);   // 提交 path（nullptr=全部）已攒的记录
\ No newline at end of file
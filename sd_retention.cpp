@@ -0,0 +1,185 @@
+#include "sd_retention.h"
+#include "sd_async.h"
+#include "photo_catalog.h"
+#include "image_store.h"
+#include "uart_utils.h"
+#include <SD.h>
+#include <FS.h>
+#include <Preferences.h>
+
+static bool     s_ready = false;
+static uint64_t s_free = 0;             // 估算剩余字节
+static uint64_t s_async_written = 0;    // 上次计入时 sd_async 的累计写入量
+static uint32_t s_cursor = 0;           // 其之前的目录记录都已删除
+static uint32_t s_cursor_saved = 0;
+static uint32_t s_cursor_save_ms = 0;
+static uint64_t s_evicted_bytes = 0;
+static RetentionStats s_stats = {0, 0, 0, 0, 0, false};
+
+static const uint64_t MB = 1024ULL * 1024ULL;
+
+static void measure_free() {
+    uint64_t total = SD.totalBytes(), used = SD.usedBytes();
+    s_free = total > used ? total - used : 0;
+    SdAsyncStats st;
+    sd_async_get_stats(st);
+    s_async_written = st.bytes_written;
+    s_stats.last_measure_ms = millis();
+}
+
+static void account_async_writes() {
+    SdAsyncStats st;
+    sd_async_get_stats(st);
+    uint64_t d = st.bytes_written - s_async_written;
+    s_async_written = st.bytes_written;
+    s_free = s_free > d ? s_free - d : 0;
+}
+
+// 游标只是加速：掉电丢失只会多扫几条已删除的记录，按 NVS_MIN_SAVE_INTERVAL_MS 节流，清理结束时强制保存
+static void save_cursor(bool force = false) {
+    if (s_cursor == s_cursor_saved) return;
+    if (!force && millis() - s_cursor_save_ms < NVS_MIN_SAVE_INTERVAL_MS) return;
+    Preferences p;
+    if (!p.begin("ret", false)) return;
+    p.putUInt("cur", s_cursor);
+    p.end();
+    s_cursor_saved = s_cursor;
+    s_cursor_save_ms = millis();
+}
+
+bool retention_init() {
+    Preferences p;
+    if (p.begin("ret", true)) {
+        s_cursor = p.getUInt("cur", 0);
+        p.end();
+    }
+    s_cursor_saved = s_cursor;
+    measure_free();
+    s_ready = true;
+    return true;
+}
+
+void retention_note_written(uint32_t bytes) {
+    s_free = s_free > bytes ? s_free - bytes : 0;
+}
+
+// 删除一条目录记录对应的数据，返回释放的字节数（估算）
+static uint64_t evict_one(const CatalogRec& r) {
+    uint32_t id;
+    if (image_store_parse_name(r.name, &id)) {
+        // 容器图片无法单删：整段删除（当前写入段除外）。段内其余记录随后仅标记删除
+        char bin[48], idx[48];
+        snprintf(bin, sizeof(bin), "%s/seg_%05lu.bin", IMGSTORE_DIR, (unsigned long)(id >> 16));
+        snprintf(idx, sizeof(idx), "%s/seg_%05lu.idx", IMGSTORE_DIR, (unsigned long)(id >> 16));
+        if (!SD.exists(bin)) return 0;
+        if (!SD.remove(bin)) return 0;
+        SD.remove(idx);
+        return IMGSTORE_SEG_SIZE;
+    }
+    uint64_t freed = 0;
+    if (SD.remove(r.name)) freed += r.len;
+    // 缩略图一并清掉
+    char thumb[72];
+    strncpy(thumb, r.name, sizeof(thumb) - 1);
+    thumb[sizeof(thumb) - 1] = '\0';
+    char* dot = strrchr(thumb, '.');
+    if (dot) {
+        *dot = '\0';
+        strncat(thumb, "_t.jpg", sizeof(thumb) - strlen(thumb) - 1);
+        SD.remove(thumb);
+    }
+    return freed;
+}
+
+static bool is_current_segment(const CatalogRec& r) {
+    uint32_t id;
+    if (!image_store_parse_name(r.name, &id)) return false;
+    uint32_t cur;
+    return image_store_current_segment(&cur) && (id >> 16) == cur;
+}
+
+// 一轮扫描：从 s_cursor 起每步看 RETAIN_SCAN_WINDOW 条（只打开一次目录文件），找到已上传的就删；
+// 一整轮都没找到已上传的，才删本轮见到的最旧一条
+static uint32_t s_scan = 0;                  // 本轮下一步的起点
+static uint32_t s_pass_oldest = UINT32_MAX;  // 本轮见到的最旧可删记录
+static bool     s_pass_found = false;        // 本轮删过已上传的
+
+struct ScanCtx {
+    bool     leading;    // 仍在游标后连续已删除的记录上
+    uint32_t pick;
+    CatalogRec rec;      // 选中的记录（省得再读一次）
+};
+
+static bool scan_visit(uint32_t idx, const CatalogRec& r, void* p) {
+    ScanCtx& c = *(ScanCtx*)p;
+    if (r.flags & CAT_F_DELETED) {
+        if (c.leading) s_cursor = idx + 1;
+        return true;
+    }
+    c.leading = false;
+    if (is_current_segment(r)) return true;
+    if (s_pass_oldest == UINT32_MAX) s_pass_oldest = idx;
+    if (r.flags & CAT_F_UPLOADED) { c.pick = idx; c.rec = r; return false; }
+    return true;
+}
+
+static void restart_pass() {
+    s_scan = s_cursor;
+    s_pass_oldest = UINT32_MAX;
+    s_pass_found = false;
+}
+
+static void evict_step() {
+    if (s_scan < s_cursor) restart_pass();
+    ScanCtx c;
+    c.leading = s_scan == s_cursor;
+    c.pick = UINT32_MAX;
+    uint32_t next = catalog_scan(s_scan, RETAIN_SCAN_WINDOW, scan_visit, &c);
+
+    bool forced = false;
+    uint32_t pick = c.pick;
+    if (pick != UINT32_MAX) {
+        s_scan = pick + 1;           // 之前的都不是已上传，下一步从这里接着找
+        s_pass_found = true;
+    } else if (next < catalog_count()) {
+        s_scan = next;               // 本窗口没有已上传的：下一步看下一窗口，本步不删
+        save_cursor();
+        return;
+    } else {
+        bool full = !s_pass_found;   // 整轮都没有已上传的：删最旧的
+        pick = s_pass_oldest;
+        restart_pass();
+        if (!full) { save_cursor(); return; }   // 本轮删过已上传的：重新扫一轮再说
+        forced = true;
+    }
+    if (pick == UINT32_MAX) { save_cursor(); return; }
+
+    CatalogRec r = c.rec;
+    if (forced && (!catalog_get(pick, r) || (r.flags & CAT_F_DELETED))) return;
+    uint64_t freed = evict_one(r);
+    catalog_set_flags(pick, CAT_F_DELETED);
+    s_free += freed;
+    s_stats.evicted_files++;
+    s_evicted_bytes += freed;
+    s_stats.evicted_mb = (uint32_t)(s_evicted_bytes / MB);
+    if (forced) s_stats.evicted_unuploaded++;
+    save_cursor();
+    log2Str("[RET] Evicted ", r.name);
+}
+
+void retention_drive() {
+    if (!s_ready || !sd_async_idle()) return;   // 写任务忙时不抢SD
+    account_async_writes();
+    if (millis() - s_stats.last_measure_ms > RETAIN_REMEASURE_MS) measure_free();
+
+    const uint64_t lo = (uint64_t)SD_MIN_FREE_MB * MB;
+    const uint64_t hi = (uint64_t)(SD_MIN_FREE_MB + RETAIN_HYSTERESIS_MB) * MB;
+    if (s_free < lo && !s_stats.active) { s_stats.active = true; restart_pass(); }
+    else if (s_free >= hi && s_stats.active) { s_stats.active = false; save_cursor(true); }
+    s_stats.free_mb = (uint32_t)(s_free / MB);
+    if (s_stats.active) evict_step();
+}
+
+void retention_get_stats(RetentionStats& out) {
+    out = s_stats;
+}
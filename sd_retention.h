@@ -0,0 +1,24 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+struct RetentionStats {
+    uint32_t free_mb;            // 当前估算的剩余空间
+    uint32_t evicted_files;
+    uint32_t evicted_mb;
+    uint32_t evicted_unuploaded; // 已上传的删光后被迫删除的未上传照片
+    uint32_t last_measure_ms;    // 上次实测剩余空间的时刻
+    bool     active;             // 正在清理（低于下限，未回到下限+回差）
+};
+
+// 保留策略：剩余空间低于 SD_MIN_FREE_MB 时按目录文件从旧到新删除，优先删已上传的。
+// 剩余空间开机实测一次，之后按写入/删除量增量估算，写任务空闲时定期校准
+bool retention_init();
+
+// 主循环调用（periodic_sd_check 内）：仅在 sd_async 空闲时执行，每次最多删一张
+void retention_drive();
+
+// 新写入的字节（未经 sd_async 的同步写由调用方上报）
+void retention_note_written(uint32_t bytes);
+
+void retention_get_stats(RetentionStats& out);
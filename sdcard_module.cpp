@@ -1,100 +1,194 @@
-#include "sdcard_module.h"
-#include "config.h"
-#include "sd_async.h"
-#include "rtc_soft.h"
-
-SPIClass sdSPI(VSPI);
-
-// 本地递增计数用于生成唯一文件名（避免重复覆盖）
-static uint32_t s_photo_counter = 0;
-
-void init_sd() {
-    sdSPI.begin(SD_SCK, SD_MISO, SD_MOSI, SD_CS);
-    if (!SD.begin(SD_CS, sdSPI)) {};
-}
-
-// 生成文件名：优先用RTC时间，其次用millis和本地计数
-static void make_photo_name(char* out, size_t outSize) {
-    if (rtc_is_valid()) {
-        PlatformTime t;
-        rtc_now_fields(&t);
-        // /IMG_YYYYMMDD_HHMMSS_NNN.jpg
-        snprintf(out, outSize, "/IMG_%04u%02u%02u_%02u%02u%02u_%03lu.jpg",
-                 (unsigned)t.year, (unsigned)t.month, (unsigned)t.day,
-                 (unsigned)t.hour, (unsigned)t.minute, (unsigned)t.second,
-                 (unsigned long)(s_photo_counter % 1000));
-    } else {
-        // RTC无效时用millis+计数
-        snprintf(out, outSize, "/IMG_ms%010lu_%03lu.jpg",
-                 (unsigned long)millis(),
-                 (unsigned long)(s_photo_counter % 1000));
-    }
-    s_photo_counter++;
-}
-
-bool save_frame_to_sd(camera_fb_t *fb, uint32_t index) {
-    if (!fb) return false;
-    // 忽略传入index，使用自带唯一命名
-    char name[64];
-    make_photo_name(name, sizeof(name));
-    return save_frame_to_sd_raw(fb->buf, fb->len, index); // 内部会重新计算文件名
-}
-
-bool save_frame_to_sd_raw(const uint8_t* data, size_t len, uint32_t index) {
-    if (SD.cardType() == CARD_NONE) return false;
-
-    char name[64];
-    make_photo_name(name, sizeof(name));
-
-    // 若启用异步SD写，优先尝试入队；失败则回退同步写，避免数据丢失
-    if (g_cfg.asyncSDWrite) {
-        if (sd_async_submit(name, data, len)) {
-            // 入队成功，立即返回，不阻塞
-            return true;
-        }
-        // 队列满或内存不足，继续走同步写
-    }
-
-    File f = SD.open(name, FILE_WRITE);
-    if (!f) return false;
-    size_t w = f.write(data, len);
-    f.close();
-    return w == len;
-}
-
-// 新增：保存并返回实际文件名（时间命名）
-bool save_frame_to_sd_with_name(camera_fb_t* fb, char* outFile, size_t outFileSize) {
-    if (!fb) return false;
-    if (!outFile || outFileSize < 4) return false;
-
-    char name[64];
-    make_photo_name(name, sizeof(name));
-
-    bool ok = false;
-    if (g_cfg.asyncSDWrite) {
-        // 异步入队（写线程会逐块写入），此处立即返回true
-        ok = sd_async_submit(name, fb->buf, fb->len);
-        if (!ok) {
-            // 回退同步写
-            File f = SD.open(name, FILE_WRITE);
-            if (f) {
-                size_t w = f.write(fb->buf, fb->len);
-                f.close();
-                ok = (w == fb->len);
-            }
-        }
-    } else {
-        File f = SD.open(name, FILE_WRITE);
-        if (f) {
-            size_t w = f.write(fb->buf, fb->len);
-            f.close();
-            ok = (w == fb->len);
-        }
-    }
-
-    if (ok) {
-        strncpy(outFile, name, outFileSize - 1);
-        outFile[outFileSize - 1] = '\0';
-    }
-    return ok;
+#include "sdcard_module.h"
+#include "config.h"
+#include "sd_async.h"
+#include "rtc_soft.h"
+#include "image_store.h"
+#include "photo_catalog.h"
+#include "sd_retention.h"
+#include "photo_cache.h"
+#include "uart_utils.h"
+#include <Preferences.h>
+
+SPIClass sdSPI(VSPI);
+
+// 本地递增计数 + 开机序号（NVS）用于生成唯一文件名，跨重启同一秒也不重名
+static uint32_t s_photo_counter = 0;
+static uint32_t s_boot_id = 0;
+
+void init_sd() {
+    sdSPI.begin(SD_SCK, SD_MISO, SD_MOSI, SD_CS);
+    if (!SD.begin(SD_CS, sdSPI)) {};
+    Preferences p;
+    if (p.begin("sd", false)) {
+        s_boot_id = p.getUInt("boot", 0) + 1;
+        p.putUInt("boot", s_boot_id);
+        p.end();
+    }
+}
+
+// 逐级创建 path 的父目录（已存在则跳过）
+bool sd_mkdir_parents(const char* path) {
+    char dir[ASYNC_SD_MAX_PATH];
+    strncpy(dir, path, sizeof(dir) - 1);
+    dir[sizeof(dir) - 1] = '\0';
+    for (char* p = dir + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        if (!SD.exists(dir) && !SD.mkdir(dir)) return false;
+        *p = '/';
+    }
+    return true;
+}
+
+// 生成文件名：按日/小时分目录，优先用RTC时间，其次用millis
+// /DCIM/YYYYMMDD/HH/IMG_HHMMSS_BBBB_NNNNN.jpg（B=开机序号，N=本次开机计数）
+static void make_photo_name(char* out, size_t outSize) {
+    if (rtc_is_valid()) {
+        PlatformTime t;
+        rtc_now_fields(&t);
+        snprintf(out, outSize, "%s/%04u%02u%02u/%02u/IMG_%02u%02u%02u_%04lu_%05lu.jpg",
+                 CATALOG_DIR, (unsigned)t.year, (unsigned)t.month, (unsigned)t.day,
+                 (unsigned)t.hour, (unsigned)t.hour, (unsigned)t.minute, (unsigned)t.second,
+                 (unsigned long)(s_boot_id % 10000), (unsigned long)(s_photo_counter % 100000));
+    } else {
+        // RTC无效时放 nodate 目录，用millis
+        snprintf(out, outSize, "%s/nodate/IMG_ms%010lu_%04lu_%05lu.jpg", CATALOG_DIR,
+                 (unsigned long)millis(),
+                 (unsigned long)(s_boot_id % 10000), (unsigned long)(s_photo_counter % 100000));
+    }
+    s_photo_counter++;
+}
+
+// 同步写（异步队列不可用时的回退）
+static bool write_file_sync(const char* name, const uint8_t* data, size_t len) {
+    File f = SD.open(name, FILE_WRITE);
+    if (!f && sd_mkdir_parents(name)) f = SD.open(name, FILE_WRITE);
+    if (!f) return false;
+    size_t w = f.write(data, len);
+    f.close();
+    retention_note_written((uint32_t)w);
+    return w == len;
+}
+
+// 写队列满时暂缓的照片：数据钉在写后读缓存里，主循环稍后再入队，不在拍照路径上同步写
+struct DeferredWrite {
+    char     name[64];
+    uint32_t since_ms;
+};
+static DeferredWrite s_defer[SD_DEFER_MAX];
+static uint8_t s_defer_n = 0;
+
+static bool defer_write(const char* name, const uint8_t* data, size_t len) {
+    if (s_defer_n >= SD_DEFER_MAX) return false;
+    if (!photo_cache_put(name, data, len)) return false;
+    photo_cache_pin(name, PHOTO_PIN_DEFER);
+    DeferredWrite& d = s_defer[s_defer_n++];
+    strncpy(d.name, name, sizeof(d.name) - 1);
+    d.name[sizeof(d.name) - 1] = '\0';
+    d.since_ms = millis();
+    log2Str("[SD] Queue full, deferred: ", name);
+    return true;
+}
+
+// 按暂缓顺序补交（不等待）；超过 SD_DEFER_MAX_MS 仍放不下的改为同步写
+static void defer_drive() {
+    while (s_defer_n > 0) {
+        DeferredWrite& d = s_defer[0];
+        const uint8_t* data = nullptr;
+        size_t len = 0;
+        if (photo_cache_get(d.name, &data, &len)) {
+            SdAsyncAdmit adm;
+            adm.prio = SD_ASYNC_PRIO_EVENT;
+            bool done = sd_async_submit_ex(d.name, SD_ASYNC_OFF_TRUNC, data, len, adm);
+            if (!done) {
+                if (millis() - d.since_ms < SD_DEFER_MAX_MS) return;   // 保持顺序，下轮再试
+                if (!write_file_sync(d.name, data, len)) log2Str("[SD] Deferred write failed: ", d.name);
+            }
+            photo_cache_unpin(d.name, PHOTO_PIN_DEFER);
+        }
+        s_defer_n--;
+        memmove(&s_defer[0], &s_defer[1], s_defer_n * sizeof(DeferredWrite));
+    }
+}
+
+// 主循环调用：SD连续失败超限重启；补交暂缓的照片；写任务空闲时推进保留策略
+void periodic_sd_check() {
+    static uint32_t lastMs = 0;
+    uint32_t now = millis();
+    if (now - lastMs < SD_CHECK_INTERVAL_MS) return;
+    lastMs = now;
+    // 异步保存提交即返回成功，写失败只有写任务知道：两边的连续失败都计入
+    SdAsyncStats st;
+    sd_async_get_stats(st);
+    uint32_t fails = max<uint32_t>(g_stats.consecutive_sd_fail, st.write_fail_run);
+    if (fails >= SD_FAIL_REBOOT_THRESHOLD) {
+        log2Val("[SD] Consecutive save failures, reboot: ", (int)fails);
+        sd_async_append_flush();   // 合并中的追加记录先入队，随后由 stop 写完
+        sd_async_stop(true);
+        delay(100);
+        esp_restart();
+    }
+    defer_drive();
+    retention_drive();
+}
+
+bool save_frame_to_sd(camera_fb_t *fb, uint32_t index) {
+    if (!fb) return false;
+    // 忽略传入index，使用自带唯一命名
+    char name[64];
+    make_photo_name(name, sizeof(name));
+    return save_frame_to_sd_raw(fb->buf, fb->len, index); // 内部会重新计算文件名
+}
+
+bool save_frame_to_sd_raw(const uint8_t* data, size_t len, uint32_t index) {
+    (void)index;
+    if (SD.cardType() == CARD_NONE) return false;
+    char name[64];
+    return save_buffer_to_sd_with_name(data, len, name, sizeof(name));
+}
+
+// 新增：保存并返回实际文件名（时间命名）
+bool save_frame_to_sd_with_name(camera_fb_t* fb, char* outFile, size_t outFileSize) {
+    if (!fb) return false;
+    return save_buffer_to_sd_with_name(fb->buf, fb->len, outFile, outFileSize);
+}
+
+// 保存任意JPEG缓冲（连拍等不持有camera_fb_t的场景），返回实际文件名
+bool save_buffer_to_sd_with_name(const uint8_t* data, size_t len, char* outFile, size_t outFileSize) {
+    if (!data || len == 0) return false;
+    if (!outFile || outFileSize < 4) return false;
+
+    // 容器存储：追加到段文件，返回逻辑名；入队失败时退回单文件写
+    uint32_t id;
+    if (image_store_ready() && image_store_append(data, len, rtc_now(), 0, &id)) {
+        image_store_make_name(id, outFile, outFileSize);
+        catalog_add(outFile, rtc_now(), (uint32_t)len);
+        photo_cache_put(outFile, data, len);
+        return true;
+    }
+
+    char name[64];
+    make_photo_name(name, sizeof(name));
+
+    bool ok = false;
+    if (g_cfg.asyncSDWrite) {
+        // 事件照片走高优先级环，放不下时等写任务腾出空间（被唤醒而非定时睡眠）；
+        // 仍放不下则暂存缓存稍后补交，缓存也放不下才回退同步写
+        SdAsyncAdmit adm;
+        adm.prio = SD_ASYNC_PRIO_EVENT;
+        adm.wait_ms = ASYNC_SD_SUBMIT_TIMEOUT_MS;
+        ok = sd_async_submit_ex(name, SD_ASYNC_OFF_TRUNC, data, len, adm);
+        if (!ok) ok = defer_write(name, data, len);
+        if (!ok) ok = write_file_sync(name, data, len);
+    } else {
+        ok = write_file_sync(name, data, len);
+    }
+
+    if (ok) {
+        strncpy(outFile, name, outFileSize - 1);
+        outFile[outFileSize - 1] = '\0';
+        catalog_add(name, rtc_now(), (uint32_t)len);
+        photo_cache_put(name, data, len);   // 上传直接读内存副本，不等SD写完
+    }
+    return ok;
 }
\ No newline at end of file
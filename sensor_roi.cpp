@@ -0,0 +1,66 @@
+#include "sensor_roi.h"
+#include "uart_utils.h"
+
+// OV2640 驱动中 set_res_raw 的 startX 即传感器模式：0=UXGA 全幅读出（原生细节）
+static const int OV2640_MODE_UXGA_RAW = 0;
+static const uint16_t OV2640_FULL_W = 1600;
+static const uint16_t OV2640_FULL_H = 1200;
+
+static RoiMeta s_meta = {false, 0, 0, 0, 0, 0, 0, OV2640_FULL_W, OV2640_FULL_H};
+
+bool roi_apply(sensor_t* s) {
+    s_meta.active = false;
+#if ROI_ENABLE
+    if (!s || !s->set_res_raw) return false;
+    if (s->id.PID != OV2640_PID) {
+        log2("[ROI] Sensor is not OV2640, ROI disabled.");
+        return false;
+    }
+
+    // 参数校验：窗口在全幅内，输出不放大、4对齐，且不超过帧缓冲
+    uint16_t x = ROI_X & ~3, y = ROI_Y & ~3;
+    uint16_t w = ROI_W & ~3, h = ROI_H & ~3;
+    uint16_t ow = ROI_OUT_W & ~3, oh = ROI_OUT_H & ~3;
+    if (w == 0 || h == 0 || x + w > OV2640_FULL_W || y + h > OV2640_FULL_H) {
+        log2("[ROI] Window out of sensor range, ROI disabled.");
+        return false;
+    }
+    if (ow == 0 || oh == 0 || ow > w || oh > h) {
+        log2("[ROI] Output must be within window (downscale only), ROI disabled.");
+        return false;
+    }
+    framesize_t fs = (framesize_t)s->status.framesize;
+    if ((uint32_t)ow * oh > (uint32_t)resolution[fs].width * resolution[fs].height) {
+        log2("[ROI] Output larger than init frame size, ROI disabled.");
+        return false;
+    }
+
+    if (s->set_res_raw(s, OV2640_MODE_UXGA_RAW, 0, 0, 0, x, y, w, h, ow, oh, false, false) != 0) {
+        log2("[ROI] set_res_raw failed, ROI disabled.");
+        return false;
+    }
+
+    s_meta.active = true;
+    s_meta.x = x; s_meta.y = y; s_meta.w = w; s_meta.h = h;
+    s_meta.out_w = ow; s_meta.out_h = oh;
+    log2("[ROI] Sensor window applied.");
+    return true;
+#else
+    (void)s;
+    return false;
+#endif
+}
+
+bool roi_is_active() { return s_meta.active; }
+
+void roi_get_meta(RoiMeta& out) { out = s_meta; }
+
+size_t roi_format_meta(char* out, size_t outSize) {
+    if (!out || outSize == 0) return 0;
+    int n = snprintf(out, outSize, "ROI %u,%u,%u,%u OUT %u,%u FULL %u,%u",
+                     (unsigned)s_meta.x, (unsigned)s_meta.y, (unsigned)s_meta.w, (unsigned)s_meta.h,
+                     (unsigned)s_meta.out_w, (unsigned)s_meta.out_h,
+                     (unsigned)s_meta.full_w, (unsigned)s_meta.full_h);
+    if (n < 0) return 0;
+    return (size_t)n < outSize ? (size_t)n : outSize - 1;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <Arduino.h>
+#include "esp_camera.h"
+#include "config.h"
+
+// 当前生效的开窗参数（供平台还原画面位置）
+struct RoiMeta {
+    bool     active;
+    uint16_t x, y, w, h;       // 全幅坐标下的窗口
+    uint16_t out_w, out_h;     // 实际输出尺寸
+    uint16_t full_w, full_h;   // 传感器全幅
+};
+
+// 相机初始化/重初始化后调用：按 ROI_* 配置通过 set_res_raw 设置 OV2640 窗口与缩放
+bool roi_apply(sensor_t* s);
+bool roi_is_active();
+void roi_get_meta(RoiMeta& out);
+
+// 元数据文本："ROI x,y,w,h OUT w,h FULL w,h"
+size_t roi_format_meta(char* out, size_t outSize);
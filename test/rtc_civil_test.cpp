@@ -0,0 +1,41 @@
+// 主机测试：civil_date.h 与 libc 的 timegm/gmtime 逐日对照（2000-01-01 .. 2100-12-31）
+// 编译运行：g++ -std=c++11 -O2 -I.. rtc_civil_test.cpp -o rtc_civil_test && ./rtc_civil_test
+#include "civil_date.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+int main() {
+    struct tm t;
+    memset(&t, 0, sizeof(t));
+    t.tm_year = 2000 - 1900;
+    t.tm_mon = 0;
+    t.tm_mday = 1;
+    const time_t first = timegm(&t);
+    t.tm_year = 2100 - 1900;
+    t.tm_mon = 11;
+    t.tm_mday = 31;
+    const time_t last = timegm(&t);
+
+    unsigned long days = 0, bad = 0;
+    for (time_t s = first; s <= last; s += 86400) {
+        struct tm ref;
+        gmtime_r(&s, &ref);
+        const int32_t z = (int32_t)(s / 86400);
+        const int32_t got_z = days_from_civil(ref.tm_year + 1900, (uint32_t)ref.tm_mon + 1, (uint32_t)ref.tm_mday);
+        int32_t y;
+        uint32_t m, d;
+        civil_from_days(z, &y, &m, &d);
+        if (got_z != z || y != ref.tm_year + 1900 || m != (uint32_t)ref.tm_mon + 1 || d != (uint32_t)ref.tm_mday) {
+            if (bad < 10) {
+                printf("mismatch at %04d-%02d-%02d: days %ld/%ld, civil %04ld-%02lu-%02lu\n",
+                       ref.tm_year + 1900, ref.tm_mon + 1, ref.tm_mday, (long)got_z, (long)z,
+                       (long)y, (unsigned long)m, (unsigned long)d);
+            }
+            bad++;
+        }
+        days++;
+    }
+    printf("%lu days checked, %lu mismatches\n", days, bad);
+    return bad ? 1 : 0;
+}
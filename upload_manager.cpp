@@ -1,185 +1,445 @@
-#include "upload_manager.h"
-#include "config.h"
-#include "platform_packet.h"
-#include "comm_manager.h"
-#include "rtc_soft.h"
-#include "sd_async.h"
-#include <Arduino.h>
-#include <FS.h>
-#include <SD.h>
-
-// 定时上传的计时器
-static uint32_t lastRealtimeUploadMs = 0;
-
-// 事件上传标志（在 main.ino 中定义，这里只声明使用）
-extern volatile int g_monitorEventUploadFlag;
-
-// 最后一张照片文件名（由 capture_trigger 维护）
-extern char g_lastPhotoName[64];
-
-// ============ 新增：只上报一次开机状态 ============
-static bool g_startupReported = false;
-
-static bool g_simInfoUploaded = false;
-
-static void uploadSimInfoIfNeeded() {
-    if (g_simInfoUploaded) return;
-    if (!comm_isConnected()) {
-        return;
-    }
-    if (!rtc_is_valid()) {
-        log2("[SIMUP] RTC not valid, skip.");
-        return;
-    }
-
-    log2("[SIMUP] Try collect SIM info");
-    SimInfo sim;
-    if (!siminfo_query(&sim)) {
-        log2("[SIMUP] SIM info collect fail, skip upload.");
-        return;
-    }
-
-    PlatformTime t;
-    rtc_now_fields(&t);
-
-    log2Str("[SIMUP] Ready upload ICCID: ", sim.iccid);
-    log2Str("[SIMUP] Ready upload IMSI: ", sim.imsi);
-
-    sendSimInfoUpload(
-        t.year, t.month, t.day, t.hour, t.minute, t.second,
-        sim.iccid, sim.iccid_len,
-        sim.imsi,  sim.imsi_len,
-        sim.signal
-    );
-    log2("[SIMUP] SIM info upload sent.");
-    g_simInfoUploaded = true;
-}
-
-// 开机自动上报（只上报一次，校时+联网后）
-static void uploadStartupStatusIfNeeded() {
-    if (g_startupReported) return;
-    if (!comm_isConnected()) return;
-    if (!rtc_is_valid()) return;
-
-    PlatformTime t;
-    rtc_now_fields(&t);
-
-    // CMD=0x0002开机状态上报
-    sendStartupStatusReport(
-        t.year, t.month, t.day, t.hour, t.minute, t.second,
-        0 // 默认状态字0
-    );
-    g_startupReported = true;
-}
-
-static void uploadRealtimeDataIfNeeded(uint32_t now) {
-    if (!comm_isConnected()) return;
-    if (!rtc_is_valid()) {
-        return;
-    }
-    if (now - lastRealtimeUploadMs < REALTIME_UPLOAD_INTERVAL_MS) return;
-
-    PlatformTime t;
-    rtc_now_fields(&t);
-
-    sendRealtimeMonitorData(
-        t.year, t.month, t.day, t.hour, t.minute, t.second, // 用2字节year
-        0,
-        nullptr,
-        0
-    );
-
-    lastRealtimeUploadMs = now;
-}
-
-// 将 g_lastPhotoName 指向的文件读取到内存（≤65000），成功返回malloc的指针与长度
-static uint8_t* read_photo_into_ram(size_t& outLen) {
-    outLen = 0;
-    if (!g_lastPhotoName[0]) return nullptr;
-
-    // 如果启用异步写，且还未空闲，则暂缓上传，等下一轮
-    if (g_cfg.asyncSDWrite && !sd_async_idle()) {
-        return nullptr;
-    }
-
-    File f = SD.open(g_lastPhotoName, FILE_READ);
-    if (!f) {
-        Serial.println("[UPLOAD] Photo file open failed!");
-        return nullptr;
-    }
-    size_t sz = f.size();
-    if (sz == 0) {
-        f.close();
-        Serial.println("[UPLOAD] Photo file size=0!");
-        return nullptr;
-    }
-    if (sz > 65000) {
-        f.close();
-        Serial.println("[UPLOAD] Photo too large (>65K), skip upload.");
-        return nullptr;
-    }
-    uint8_t* buf = (uint8_t*)malloc(sz);
-    if (!buf) {
-        f.close();
-        Serial.println("[UPLOAD] malloc failed for photo buffer!");
-        return nullptr;
-    }
-    size_t n = f.read(buf, sz);
-    f.close();
-    if (n != sz) {
-        free(buf);
-        Serial.println("[UPLOAD] Photo read size mismatch!");
-        return nullptr;
-    }
-    outLen = sz;
-    return buf;
-}
-
-static void uploadMonitorEventIfNeeded() {
-    if (!comm_isConnected()) return;
-    if (!rtc_is_valid()) {
-        return;
-    }
-    if (g_monitorEventUploadFlag != 1) return;
-
-    // 读取图片数据
-    size_t imgLen = 0;
-    uint8_t* imageData = read_photo_into_ram(imgLen);
-    if (!imageData && g_cfg.asyncSDWrite) {
-        // 异步未空闲，或读取失败，下一轮再试（不清标志）
-        return;
-    }
-
-    PlatformTime t;
-    rtc_now_fields(&t);
-
-    uint8_t triggerCond = 1;
-    float realtimeValue = 0.0f;   // 可按需填写
-    float thresholdValue = 0.0f;  // 可按需填写
-
-    // 如果没读到图片（可能是异步未完成、或大于65K、或其它失败），按需求：可只发元数据，或跳过
-    if (imageData && imgLen > 0 && imgLen <= 65000) {
-        sendMonitorEventUpload(
-            t.year, t.month, t.day, t.hour, t.minute, t.second, triggerCond,
-            realtimeValue, thresholdValue, imageData, (uint32_t)imgLen
-        );
-        free(imageData);
-    } else {
-        Serial.println("[UPLOAD] No image attached (either too large or not ready). Send meta only.");
-        sendMonitorEventUpload(
-            t.year, t.month, t.day, t.hour, t.minute, t.second, triggerCond,
-            realtimeValue, thresholdValue, nullptr, 0
-        );
-    }
-
-    // 按你的要求：上传成功不删除本地文件，这里不做删除
-    g_monitorEventUploadFlag = 0; // 上传一次后清零
-}
-
-void upload_drive() {
-    uint32_t now = millis();
-    uploadStartupStatusIfNeeded();     // 开机状态上报
-    uploadSimInfoIfNeeded();           // SIM卡状态上报
-    uploadRealtimeDataIfNeeded(now);   // 实时数据上报
-    uploadMonitorEventIfNeeded();      // 事件图片上传
+#include "upload_manager.h"
+#include "config.h"
+#include "platform_packet.h"
+#include "comm_manager.h"
+#include "rtc_soft.h"
+#include "sd_async.h"
+#include "jpeg_tools.h"
+#include "sensor_roi.h"
+#include "water_level.h"
+#include "image_store.h"
+#include "photo_catalog.h"
+#include "photo_cache.h"
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <FS.h>
+#include <SD.h>
+
+// 定时上传的计时器
+static uint32_t lastRealtimeUploadMs = 0;
+
+// 事件上传标志（在 main.ino 中定义，这里只声明使用）
+extern volatile int g_monitorEventUploadFlag;
+
+// 最后一张照片文件名与触发条件（由 capture_trigger 维护）
+extern char g_lastPhotoName[64];
+extern uint8_t g_lastTriggerCond;
+extern bool g_lastEventMetaOnly;
+
+// ============ 新增：只上报一次开机状态 ============
+static bool g_startupReported = false;
+
+static bool g_simInfoUploaded = false;
+
+static void uploadSimInfoIfNeeded() {
+    if (g_simInfoUploaded) return;
+    if (!comm_isConnected()) {
+        return;
+    }
+    if (!rtc_is_valid()) {
+        log2("[SIMUP] RTC not valid, skip.");
+        return;
+    }
+
+    log2("[SIMUP] Try collect SIM info");
+    SimInfo sim;
+    if (!siminfo_query(&sim)) {
+        log2("[SIMUP] SIM info collect fail, skip upload.");
+        return;
+    }
+
+    PlatformTime t;
+    rtc_now_fields(&t);
+
+    log2Str("[SIMUP] Ready upload ICCID: ", sim.iccid);
+    log2Str("[SIMUP] Ready upload IMSI: ", sim.imsi);
+
+    sendSimInfoUpload(
+        t.year, t.month, t.day, t.hour, t.minute, t.second,
+        sim.iccid, sim.iccid_len,
+        sim.imsi,  sim.imsi_len,
+        sim.signal
+    );
+    log2("[SIMUP] SIM info upload sent.");
+    g_simInfoUploaded = true;
+}
+
+// 开机自动上报（只上报一次，校时+联网后）
+static void uploadStartupStatusIfNeeded() {
+    if (g_startupReported) return;
+    if (!comm_isConnected()) return;
+    if (!rtc_is_valid()) return;
+
+    PlatformTime t;
+    rtc_now_fields(&t);
+
+    // CMD=0x0002开机状态上报
+    sendStartupStatusReport(
+        t.year, t.month, t.day, t.hour, t.minute, t.second,
+        0 // 默认状态字0
+    );
+    g_startupReported = true;
+}
+
+static void uploadRealtimeDataIfNeeded(uint32_t now) {
+    if (!comm_isConnected()) return;
+    if (!rtc_is_valid()) {
+        return;
+    }
+    if (now - lastRealtimeUploadMs < REALTIME_UPLOAD_INTERVAL_MS) return;
+
+    PlatformTime t;
+    rtc_now_fields(&t);
+
+    sendRealtimeMonitorData(
+        t.year, t.month, t.day, t.hour, t.minute, t.second, // 用2字节year
+        0,
+        nullptr,
+        water_level_status()
+    );
+
+    lastRealtimeUploadMs = now;
+}
+
+// 读取SD文件到内存（≤maxLen），成功返回malloc的指针与长度
+static uint8_t* read_file_into_ram(const char* path, size_t maxLen, size_t& outLen) {
+    outLen = 0;
+    uint32_t id;
+    if (image_store_parse_name(path, &id)) {
+        // 容器内图片：按id一次索引读 + 一次定位读
+        uint8_t* buf = image_store_read(id, maxLen, outLen);
+        if (!buf) Serial.println("[UPLOAD] Image store read failed!");
+        return buf;
+    }
+    File f = SD.open(path, FILE_READ);
+    if (!f) {
+        Serial.println("[UPLOAD] Photo file open failed!");
+        return nullptr;
+    }
+    size_t sz = f.size();
+    if (sz == 0) {
+        f.close();
+        Serial.println("[UPLOAD] Photo file size=0!");
+        return nullptr;
+    }
+    if (sz > maxLen) {
+        f.close();
+        Serial.println("[UPLOAD] Photo too large, skip.");
+        return nullptr;
+    }
+    // 原图可能上百KB，优先放PSRAM
+    uint8_t* buf = (uint8_t*)heap_caps_malloc(sz, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!buf) buf = (uint8_t*)malloc(sz);
+    if (!buf) {
+        f.close();
+        Serial.println("[UPLOAD] malloc failed for photo buffer!");
+        return nullptr;
+    }
+    size_t n = f.read(buf, sz);
+    f.close();
+    if (n != sz) {
+        free(buf);
+        Serial.println("[UPLOAD] Photo read size mismatch!");
+        return nullptr;
+    }
+    outLen = sz;
+    return buf;
+}
+
+#if THUMB_UPLOAD_ENABLE
+// 缩略图与原图同目录：/IMG_xxx.jpg -> /IMG_xxx_t.jpg
+static void make_thumb_path(const char* src, char* out, size_t outSize) {
+    strncpy(out, src, outSize - 1);
+    out[outSize - 1] = '\0';
+    char* dot = strrchr(out, '.');
+    if (dot) *dot = '\0';
+    strncat(out, "_t.jpg", outSize - strlen(out) - 1);
+}
+
+// 原图转码为缩略图（不释放 src）；非容器图片顺带落盘，重传时直接读
+static uint8_t* thumb_from_source(const uint8_t* src, size_t srcLen, bool inStore, size_t& outLen) {
+    outLen = 0;
+    uint8_t* jpg = nullptr;
+    size_t jpgLen = 0;
+    if (!jpeg_transcode_to_budget(src, srcLen, THUMB_MAX_BYTES, THUMB_MIN_SCALE, &jpg, &jpgLen)) {
+        Serial.println("[UPLOAD] Thumbnail transcode failed.");
+        return nullptr;
+    }
+    char thumb[72];
+    make_thumb_path(g_lastPhotoName, thumb, sizeof(thumb));
+    if (!inStore && !sd_async_submit(thumb, jpg, jpgLen)) {
+        Serial.println("[UPLOAD] Thumbnail save skipped (queue busy).");
+    }
+    log2Val("[UPLOAD] Thumbnail bytes: ", (int)jpgLen);
+    outLen = jpgLen;
+    return jpg;
+}
+
+// 取缩略图：SD上已有则直接读（重传场景），否则从原图转码并落盘
+static uint8_t* load_thumbnail_into_ram(size_t& outLen) {
+    outLen = 0;
+    char thumb[72];
+    // 容器内图片不另存缩略图文件（保持容器模式下不新建FAT文件），每次转码
+    bool inStore = image_store_parse_name(g_lastPhotoName, nullptr);
+    make_thumb_path(g_lastPhotoName, thumb, sizeof(thumb));
+    if (!inStore && SD.exists(thumb)) {
+        return read_file_into_ram(thumb, 65000, outLen);
+    }
+
+    size_t srcLen = 0;
+    uint8_t* src = read_file_into_ram(g_lastPhotoName, THUMB_SRC_MAX_BYTES, srcLen);
+    if (!src) return nullptr;
+    uint8_t* jpg = thumb_from_source(src, srcLen, inStore, outLen);
+    free(src);
+    return jpg;
+}
+#endif
+
+// SD上的待上传照片经 sd_async 异步读入（写任务执行，主循环不阻塞）：
+// 先试缩略图文件（重传场景已存在），读不到再读原图。上传流程每轮轮询，读完再发
+enum PhotoLoadState { PL_IDLE, PL_BUSY, PL_DONE, PL_FAIL };
+
+struct PhotoLoad {
+    char           name[64];   // 对应的 g_lastPhotoName
+    bool           thumb;      // 当前读的是缩略图文件
+    int            stream;
+    uint8_t*       buf;
+    size_t         len;
+    size_t         cap;        // 文件大小（首块回调时得知）
+    size_t         maxLen;
+    PhotoLoadState st;
+};
+static PhotoLoad s_load = {{0}, false, -1, nullptr, 0, 0, 0, PL_IDLE};
+
+static void photo_load_fail(PhotoLoad& L) {
+    if (L.buf) free(L.buf);
+    L.buf = nullptr;
+    L.len = L.cap = 0;
+    L.st = PL_FAIL;
+}
+
+// sd_async_poll 中回调：按偏移拼进PSRAM缓冲
+static void photo_load_cb(void* ctx, const uint8_t* data, size_t len, uint32_t offset, uint32_t fileSize, int status) {
+    PhotoLoad& L = *(PhotoLoad*)ctx;
+    if (L.st != PL_BUSY) return;
+    if (status == SD_ASYNC_RD_ERR) { photo_load_fail(L); return; }
+    if (!L.buf) {
+        if (fileSize == 0 || fileSize > L.maxLen) {
+            sd_async_read_cancel(L.stream);
+            photo_load_fail(L);
+            return;
+        }
+        L.buf = (uint8_t*)heap_caps_malloc(fileSize, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!L.buf) L.buf = (uint8_t*)malloc(fileSize);
+        if (!L.buf) {
+            sd_async_read_cancel(L.stream);
+            photo_load_fail(L);
+            return;
+        }
+        L.cap = fileSize;
+    }
+    if (offset + len > L.cap) {
+        sd_async_read_cancel(L.stream);
+        photo_load_fail(L);
+        return;
+    }
+    memcpy(L.buf + offset, data, len);
+    L.len = offset + len;
+    if (status == SD_ASYNC_RD_EOF) {
+        if (L.len == L.cap) L.st = PL_DONE;
+        else photo_load_fail(L);
+    }
+}
+
+static bool photo_load_start(bool thumb) {
+    PhotoLoad& L = s_load;
+    char path[72];
+    strncpy(path, L.name, sizeof(path) - 1);
+    path[sizeof(path) - 1] = '\0';
+#if THUMB_UPLOAD_ENABLE
+    if (thumb) make_thumb_path(L.name, path, sizeof(path));
+#endif
+    if (L.buf) free(L.buf);
+    L.buf = nullptr;
+    L.len = L.cap = 0;
+    L.thumb = thumb;
+#if THUMB_UPLOAD_ENABLE
+    L.maxLen = thumb ? 65000 : THUMB_SRC_MAX_BYTES;
+#else
+    L.maxLen = 65000;
+#endif
+    L.st = PL_BUSY;
+    L.stream = sd_async_read(path, 0, photo_load_cb, &L);
+    if (L.stream < 0) L.st = PL_IDLE;
+    return L.stream >= 0;
+}
+
+// 轮询异步读：读完返回图片（缩略图或转码后的缩略图/原图），pending=true 表示还在读。
+// 写任务未运行等无法异步读时返回 nullptr 且 pending=false，由调用方同步读
+static uint8_t* photo_load_poll(size_t& outLen, bool& pending, bool& started) {
+    PhotoLoad& L = s_load;
+    outLen = 0;
+    pending = false;
+    started = true;
+    if (strncmp(L.name, g_lastPhotoName, sizeof(L.name)) != 0) {
+        if (L.st == PL_BUSY) sd_async_read_cancel(L.stream);
+        strncpy(L.name, g_lastPhotoName, sizeof(L.name) - 1);
+        L.name[sizeof(L.name) - 1] = '\0';
+        if (!photo_load_start(THUMB_UPLOAD_ENABLE ? true : false)) {
+            L.name[0] = '\0';
+            started = false;
+            return nullptr;
+        }
+    }
+    if (L.st == PL_BUSY) { pending = true; return nullptr; }
+    if (L.st == PL_FAIL && L.thumb) {
+        // 没有现成缩略图：改读原图
+        pending = photo_load_start(false);
+        return nullptr;
+    }
+    if (L.st != PL_DONE) { L.name[0] = '\0'; L.st = PL_IDLE; return nullptr; }
+
+    uint8_t* buf = L.buf;
+    size_t len = L.len;
+    bool thumb = L.thumb;
+    L.buf = nullptr;
+    L.name[0] = '\0';
+    L.st = PL_IDLE;
+#if THUMB_UPLOAD_ENABLE
+    if (!thumb) {
+        size_t tl = 0;
+        uint8_t* t = thumb_from_source(buf, len, false, tl);
+        if (t) { free(buf); buf = t; len = tl; }
+    }
+#else
+    (void)thumb;
+#endif
+    if (len > 65000) {
+        free(buf);
+        Serial.println("[UPLOAD] Photo too large, skip.");
+        return nullptr;
+    }
+    outLen = len;
+    return buf;
+}
+
+// 开窗模式下，把裁剪元数据以JPEG COM段附在上传图片里，平台据此还原窗口位置。
+// owned=false 的图片（缓存里的）不释放；附加成功后得到的新缓冲 owned=true
+static const uint8_t* attach_roi_meta(const uint8_t* img, size_t& len, bool& owned) {
+    if (!img || !roi_is_active()) return img;
+    char meta[80];
+    roi_format_meta(meta, sizeof(meta));
+    uint8_t* out = nullptr;
+    size_t outLen = 0;
+    if (!jpeg_insert_comment(img, len, meta, &out, &outLen) || outLen > 65000) {
+        if (out) free(out);
+        return img;   // 附加失败不影响图片本身上传
+    }
+    if (owned) free((void*)img);
+    owned = true;
+    len = outLen;
+    return out;
+}
+
+// 写后读缓存命中：缩略图直接从缓存副本转码，不转码时直接发送缓存副本（owned=false，不复制）
+static const uint8_t* photo_from_cache(size_t& outLen, bool& owned) {
+    const uint8_t* data = nullptr;
+    size_t len = 0;
+    if (!photo_cache_get(g_lastPhotoName, &data, &len)) return nullptr;
+#if THUMB_UPLOAD_ENABLE
+    if (len <= THUMB_SRC_MAX_BYTES) {
+        uint8_t* t = thumb_from_source(data, len, image_store_parse_name(g_lastPhotoName, nullptr), outLen);
+        if (t) { owned = true; return t; }
+    }
+#endif
+    if (len > 65000) {
+        Serial.println("[UPLOAD] Photo too large, skip.");
+        return nullptr;
+    }
+    owned = false;
+    outLen = len;
+    return data;
+}
+
+// 将 g_lastPhotoName 对应的待上传图片读入内存（≤65000）：默认缩略图，失败时退回原图。
+// SD上的文件走异步读，未读完时返回 nullptr 且 pending=true。owned=true 时由调用方 free
+static const uint8_t* read_photo_into_ram(size_t& outLen, bool& pending, bool& owned) {
+    outLen = 0;
+    pending = false;
+    owned = true;
+    if (!g_lastPhotoName[0]) return nullptr;
+
+    const uint8_t* img = nullptr;
+    if (photo_cache_has(g_lastPhotoName)) {
+        img = photo_from_cache(outLen, owned);
+        return attach_roi_meta(img, outLen, owned);
+    }
+    if (!image_store_parse_name(g_lastPhotoName, nullptr) && g_cfg.asyncSDWrite) {
+        bool started = false;
+        img = photo_load_poll(outLen, pending, started);
+        if (img || pending) return img ? attach_roi_meta(img, outLen, owned) : nullptr;
+        if (started) return nullptr;   // 异步读失败：不带图
+    }
+
+#if THUMB_UPLOAD_ENABLE
+    img = load_thumbnail_into_ram(outLen);
+#endif
+    if (!img) img = read_file_into_ram(g_lastPhotoName, 65000, outLen);
+    return attach_roi_meta(img, outLen, owned);
+}
+
+static void uploadMonitorEventIfNeeded() {
+    if (!comm_isConnected()) return;
+    if (!rtc_is_valid()) {
+        return;
+    }
+    if (g_monitorEventUploadFlag != 1) return;
+
+    // 读取图片数据（画面无变化的事件不带图，直接发元数据）
+    size_t imgLen = 0;
+    const uint8_t* imageData = nullptr;
+    bool owned = true;
+    if (!g_lastEventMetaOnly) {
+        bool pending = false;
+        imageData = read_photo_into_ram(imgLen, pending, owned);
+        if (pending) {
+            // 异步读还没完成，下一轮再试（不清标志）
+            return;
+        }
+    }
+
+    PlatformTime t;
+    rtc_now_fields(&t);
+
+    uint8_t triggerCond = g_lastTriggerCond;
+    float realtimeValue = water_level_value_m();      // 最近一次水位测量（m），未开启/无效时为0
+    float thresholdValue = water_level_threshold_m(); // 告警水位（m）
+
+    // 如果没读到图片（可能是异步未完成、或大于65K、或其它失败），按需求：可只发元数据，或跳过
+    if (imageData && imgLen > 0 && imgLen <= 65000) {
+        sendMonitorEventUpload(
+            t.year, t.month, t.day, t.hour, t.minute, t.second, triggerCond,
+            realtimeValue, thresholdValue, imageData, (uint32_t)imgLen
+        );
+        if (owned) free((void*)imageData);
+        catalog_mark_uploaded(g_lastPhotoName);   // 供补传与保留策略查询
+        photo_cache_unpin(g_lastPhotoName);
+    } else {
+        Serial.println("[UPLOAD] No image attached (either too large or not ready). Send meta only.");
+        sendMonitorEventUpload(
+            t.year, t.month, t.day, t.hour, t.minute, t.second, triggerCond,
+            realtimeValue, thresholdValue, nullptr, 0
+        );
+    }
+
+    // 按你的要求：上传成功不删除本地文件，这里不做删除
+    g_monitorEventUploadFlag = 0; // 上传一次后清零
+}
+
+void upload_drive() {
+    uint32_t now = millis();
+    uploadStartupStatusIfNeeded();     // 开机状态上报
+    uploadSimInfoIfNeeded();           // SIM卡状态上报
+    uploadRealtimeDataIfNeeded(now);   // 实时数据上报
+    uploadMonitorEventIfNeeded();      // 事件图片上传
 }
\ No newline at end of file
@@ -1,6 +1,6 @@
-#pragma once
-#include <stdint.h>
-#include "sim_info.h"
-
-// 上传调度（与业务相关：实时数据、事件等）
+#pragma once
+#include <stdint.h>
+#include "sim_info.h"
+
+// 上传调度（与业务相关：实时数据、事件等）
 void upload_drive();
\ No newline at end of file
@@ -0,0 +1,172 @@
+#include "water_level.h"
+#include "jpeg_tools.h"
+#include "capture_trigger.h"
+#include "sd_async.h"
+#include "rtc_soft.h"
+#include "uart_utils.h"
+#include <string.h>
+
+// 剖面缓冲（解码后宽高上限）
+#define WL_MAX_DIM 512
+
+static uint32_t s_col[WL_MAX_DIM];
+static uint32_t s_row[WL_MAX_DIM + 1];   // 前缀和多一格
+
+static WaterLevelResult s_last = {false, 0, 0, 0, 0, 0};
+static bool     s_over = false;
+static bool     s_cross_pending = false;
+static uint32_t s_last_sample_ms = 0;
+
+static inline uint32_t absdiff(uint8_t a, uint8_t b) { return a > b ? a - b : b - a; }
+
+// 1) 列剖面：各列竖直梯度能量（水尺刻度是横向条纹，竖直梯度强），
+//    滑窗选出能量最大的 WL_GAUGE_COLS 列作为水尺带；
+// 2) 行剖面：水尺带内每行的纹理能量（横+竖梯度）；
+// 3) 阶跃拟合：找分割行k，使上方（刻度可见）与下方（水面）纹理均值差的类间方差最大。
+// 全部行主序顺序访存，整数运算
+bool water_level_estimate_gray(const uint8_t* px, uint16_t w, uint16_t h, uint16_t stride,
+                               uint16_t* out_row, uint16_t* out_contrast_q8) {
+    if (!px || w < 4 || h < 8 || w > WL_MAX_DIM || h > WL_MAX_DIM) return false;
+
+    // 1) 列剖面
+    memset(s_col, 0, sizeof(uint32_t) * w);
+    for (uint16_t r = 0; r + 1 < h; r++) {
+        const uint8_t* p = px + (size_t)r * stride;
+        const uint8_t* q = p + stride;
+        for (uint16_t c = 0; c < w; c++) s_col[c] += absdiff(q[c], p[c]);
+    }
+    uint16_t band = WL_GAUGE_COLS < w - 1 ? WL_GAUGE_COLS : w - 1;
+    uint32_t acc = 0, best = 0;
+    uint16_t c0 = 0;
+    for (uint16_t c = 0; c < w - 1; c++) {
+        acc += s_col[c];
+        if (c >= band) acc -= s_col[c - band];
+        if (c + 1 >= band && acc > best) { best = acc; c0 = c + 1 - band; }
+    }
+
+    // 2) 行剖面（前缀和）
+    const uint16_t n = h - 1;
+    s_row[0] = 0;
+    for (uint16_t r = 0; r < n; r++) {
+        const uint8_t* p = px + (size_t)r * stride + c0;
+        const uint8_t* q = p + stride;
+        uint32_t e = 0;
+        for (uint16_t c = 0; c < band; c++) e += absdiff(p[c + 1], p[c]) + absdiff(q[c], p[c]);
+        s_row[r + 1] = s_row[r] + e;
+    }
+
+    // 3) 阶跃拟合：score = (Pk*n - k*Pn)^2 / (k*(n-k))，只取上方纹理更强的分割
+    const int64_t Pn = s_row[n];
+    int64_t bestScore = 0;
+    uint16_t bestK = 0;
+    for (uint16_t k = 2; k + 2 <= n; k++) {
+        int64_t d = (int64_t)s_row[k] * n - (int64_t)k * Pn;
+        if (d <= 0) continue;
+        int64_t score = (d / 64) * (d / 64) / ((int64_t)k * (n - k));
+        if (score > bestScore) { bestScore = score; bestK = k; }
+    }
+    if (!bestK) return false;
+
+    uint32_t above = s_row[bestK] / bestK;
+    uint32_t below = (uint32_t)(Pn - s_row[bestK]) / (n - bestK);
+    uint32_t contrast = below ? (above << 8) / below : 0xFFFF;
+    if (contrast > 0xFFFF) contrast = 0xFFFF;
+    if (contrast < WL_MIN_CONTRAST_Q8) return false;   // 上下纹理差不明显，不可信
+
+    *out_row = bestK;
+    *out_contrast_q8 = (uint16_t)contrast;
+    return true;
+}
+
+bool water_level_analyze_jpeg(const uint8_t* jpg, size_t len) {
+#if WL_ENABLE
+    uint32_t t0 = micros();
+    JpegImage img;
+    if (!jpeg_decode_scaled(jpg, len, WL_DECODE_SCALE, true, &img)) return false;
+
+    // ROI（全尺寸坐标）换算到解码图坐标；宽为0表示整幅
+    const uint16_t sh = (uint16_t)WL_DECODE_SCALE;
+    uint16_t rx = WL_ROI_X >> sh, ry = WL_ROI_Y >> sh;
+    uint16_t rw = WL_ROI_W ? (WL_ROI_W >> sh) : img.w;
+    uint16_t rh = WL_ROI_H ? (WL_ROI_H >> sh) : img.h;
+    if (rx >= img.w || ry >= img.h) { jpeg_image_free(&img); return false; }
+    if (rx + rw > img.w) rw = img.w - rx;
+    if (ry + rh > img.h) rh = img.h - ry;
+
+    uint16_t row = 0, contrast = 0;
+    bool ok = water_level_estimate_gray(img.px + (size_t)ry * img.w + rx, rw, rh, img.w, &row, &contrast);
+    jpeg_image_free(&img);
+    if (!ok) {
+        log2("[WL] No reliable water line.");
+        return false;
+    }
+
+    // 水线行换算回全尺寸像素，再按标定换算为mm（Q8定点）
+    int32_t fullRow = (int32_t)WL_ROI_Y + ((int32_t)row << sh);
+    s_last.valid = true;
+    s_last.level_mm = ((int32_t)WL_ZERO_ROW - fullRow) * (int32_t)WL_MM_PER_PX_Q8 / 256;
+    s_last.line_row = row;
+    s_last.contrast_q8 = contrast;
+    s_last.t_ms = millis();
+    s_last.cost_us = micros() - t0;
+    log2Val("[WL] Level mm: ", (int)s_last.level_mm);
+
+    // 越限判定（带回差），上穿时挂起事件
+    if (!s_over && s_last.level_mm >= WL_THRESHOLD_MM) {
+        s_over = true;
+        s_cross_pending = true;
+        log2("[WL] Threshold crossed upward.");
+    } else if (s_over && s_last.level_mm < WL_THRESHOLD_MM - WL_HYSTERESIS_MM) {
+        s_over = false;
+    }
+
+#if WL_LOG_ENABLE
+    // 测量记录很小，合并后成批追加；越限的那条立即提交
+    char line[64];
+    int n = snprintf(line, sizeof(line), "%lu,%ld,%u,%u\n", (unsigned long)rtc_now(),
+                     (long)s_last.level_mm, (unsigned)row, (unsigned)contrast);
+    if (n > 0) sd_async_append(WL_LOG_PATH, line, (size_t)n, s_cross_pending ? SD_ASYNC_DUR_COMMIT : SD_ASYNC_DUR_BUFFERED);
+#endif
+    return true;
+#else
+    (void)jpg; (void)len;
+    return false;
+#endif
+}
+
+bool water_level_last(WaterLevelResult& out) {
+    out = s_last;
+    return s_last.valid;
+}
+
+float water_level_value_m() {
+    return s_last.valid ? (float)s_last.level_mm / 1000.0f : 0.0f;
+}
+
+float water_level_threshold_m() {
+#if WL_ENABLE
+    return (float)WL_THRESHOLD_MM / 1000.0f;
+#else
+    return 0.0f;
+#endif
+}
+
+uint8_t water_level_status() {
+    if (!s_last.valid) return WL_STATUS_UNKNOWN;
+    return s_over ? WL_STATUS_OVER : WL_STATUS_NORMAL;
+}
+
+void water_level_drive() {
+#if WL_ENABLE
+    if (s_cross_pending) {
+        s_cross_pending = false;
+        // 越限事件：连拍留存过程并上传首帧
+        capture_burst(TRIGGER_WATER_LEVEL, BURST_FRAMES, BURST_INTERVAL_MS, true);
+        return;
+    }
+    uint32_t now = millis();
+    if (now - s_last_sample_ms < WL_SAMPLE_INTERVAL_MS) return;
+    s_last_sample_ms = now;
+    capture_measure_frame();
+#endif
+}
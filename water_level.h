@@ -0,0 +1,34 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// 水位状态（实时数据 waterStatus 字段）
+#define WL_STATUS_UNKNOWN  0
+#define WL_STATUS_NORMAL   1
+#define WL_STATUS_OVER     2
+
+struct WaterLevelResult {
+    bool     valid;
+    int32_t  level_mm;        // 相对水尺零点的水位（mm）
+    uint16_t line_row;        // 水线所在行（解码图坐标）
+    uint16_t contrast_q8;     // 水线上/下纹理能量比（Q8，256=1.0），置信度参考
+    uint32_t t_ms;            // 测量时刻 millis()
+    uint32_t cost_us;         // 解码+核函数耗时
+};
+
+// 灰度核：输入行主序亮度图中的水尺ROI，估计水线行（纯整数）
+bool water_level_estimate_gray(const uint8_t* px, uint16_t w, uint16_t h, uint16_t stride,
+                               uint16_t* out_row, uint16_t* out_contrast_q8);
+
+// 对一帧JPEG做测量（按 WL_DECODE_SCALE 缩放解码 + 核函数），并更新越限状态
+bool water_level_analyze_jpeg(const uint8_t* jpg, size_t len);
+
+// 最近一次有效测量
+bool water_level_last(WaterLevelResult& out);
+
+float water_level_value_m();       // 上报用 realtimeValue（m）
+float water_level_threshold_m();   // 上报用 thresholdValue（m）
+uint8_t water_level_status();      // 上报用 waterStatus
+
+// 主循环调用：按 WL_SAMPLE_INTERVAL_MS 定时取帧测量；上穿阈值时触发事件连拍
+void water_level_drive();